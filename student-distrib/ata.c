@@ -0,0 +1,424 @@
+/* ata.c - Defines the ATA (IDE) disk driver: drives of the primary channel, PIO transfers driven by IRQ 14. requests are
+ *         queued and return at once, the queue is served in one direction of the disk (C-LOOK elevator) and
+ *         requests for sectors that follow each other are merged into one command
+ * vim:ts=4 noexpandtab
+ */
+
+#include "ata.h"
+#include "lib.h"
+#include "i8259.h"
+#include "scheduler.h"
+#include "terminal.h"
+
+static uint32_t ata_sectors[ATA_NBR_DRIVES];    // nbr of sectors of each drive (0: no drive)
+static ata_request_t* ata_queue = NULL;     // commands waiting for the drive, by increasing lba
+static ata_request_t* ata_active = NULL;    // command being transferred (head of its chain)
+static ata_request_t* ata_seg = NULL;       // request of the active chain being transferred
+static uint32_t ata_seg_sector = 0;         // next sector of ata_seg
+static uint32_t ata_sectors_left = 0;       // sectors of the active command not transferred yet
+static uint32_t ata_head_lba = 0;           // sector after the last command: where the elevator is
+static wait_queue_t ata_wait_queue = WAIT_QUEUE_INITIALIZER;   // tasks waiting for a request to complete
+static ata_stats_t ata_stats;
+
+/*
+ * ata_delay
+ *   DESCRIPTION: waits 400ns (4 reads of the alternate status) for the status to be valid after a command
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: none
+ */
+static void ata_delay(void){
+    inb(ATA_CTRL_PORT);
+    inb(ATA_CTRL_PORT);
+    inb(ATA_CTRL_PORT);
+    inb(ATA_CTRL_PORT);
+}
+
+/*
+ * ata_wait_ready
+ *   DESCRIPTION: polls the status until the drive is not busy, and has data (or failed) if drq is asked for
+ *   INPUTS: drq: 1 = also wait for DRQ or ERR
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: reading the status acknowledges the interrupt of the drive
+ *   RETURN VALUE: last status read (BSY still set if the drive did not answer)
+ */
+static uint32_t ata_wait_ready(uint32_t drq){
+    uint32_t i, status = ATA_SR_BSY;
+    for (i = 0; i < ATA_POLL_LIMIT; i++){
+        status = inb(ATA_STATUS_PORT);
+        if (!(status & ATA_SR_BSY) && (!drq || (status & (ATA_SR_DRQ | ATA_SR_ERR | ATA_SR_DF))))
+            break;
+    }
+    return status;
+}
+
+/*
+ * ata_pio_in / ata_pio_out
+ *   DESCRIPTION: transfers one sector between the data port and a buffer
+ *   INPUTS: buf: sector buffer
+ *   OUTPUTS: buf: filled (ata_pio_in)
+ *   SIDE EFFECTS: the drive moves on to the next sector
+ *   RETURN VALUE: none
+ */
+static void ata_pio_in(uint8_t* buf){
+    uint32_t cnt = ATA_SECTOR_WORDS;
+    asm volatile ("cld \n rep insw" : "+D"(buf), "+c"(cnt) : "d"(ATA_DATA_PORT) : "memory");
+}
+static void ata_pio_out(const uint8_t* buf){
+    uint32_t cnt = ATA_SECTOR_WORDS;
+    asm volatile ("cld \n rep outsw" : "+S"(buf), "+c"(cnt) : "d"(ATA_DATA_PORT) : "memory");
+}
+
+/*
+ * ata_next_sector
+ *   DESCRIPTION: transfers the next sector of the active command and moves on (to the next request of the chain
+ *                at the end of a request)
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: transfers a sector
+ *   RETURN VALUE: none
+ */
+static void ata_next_sector(void){
+    uint8_t* buf = ata_seg->buf + ata_seg_sector * ATA_SECTOR_SIZE;
+    if (ata_active->write)
+        ata_pio_out(buf);
+    else
+        ata_pio_in(buf);
+    if (++ata_seg_sector == ata_seg->nbr_sectors){
+        ata_seg = ata_seg->chain_next;
+        ata_seg_sector = 0;
+    }
+    ata_sectors_left--;
+}
+
+/*
+ * ata_complete
+ *   DESCRIPTION: completes every request of the active command and wakes the tasks waiting for requests
+ *   INPUTS: status: ATA_REQ_DONE or ATA_REQ_ERROR
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: calls the done callbacks of the requests, no command is active after
+ *   RETURN VALUE: none
+ */
+static void ata_complete(int32_t status){
+    ata_request_t* req = ata_active;
+    ata_request_t* next;
+
+    if (status == ATA_REQ_DONE)
+        ata_stats.nbr_sectors += ata_active->chain_sectors;
+    else
+        ata_stats.nbr_errors++;
+    ata_active = ata_seg = NULL;
+    while (req != NULL){
+        next = req->chain_next;
+        req->next = req->chain_next = NULL;
+        req->status = status;
+        if (req->done != NULL)
+            req->done(req);
+        req = next;
+    }
+    wait_queue_wake(&ata_wait_queue);
+}
+
+/*
+ * ata_start
+ *   DESCRIPTION: sends the next command to the drive if it is idle: the first one at or past the sector the
+ *                elevator is at, else the lowest one (the elevator goes back to the start of the disk)
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: sends a command (and the first sector of a write)
+ *   RETURN VALUE: none
+ */
+static void ata_start(void){
+    ata_request_t* req;
+    ata_request_t* prev;
+
+    while (ata_active == NULL && ata_queue != NULL){
+        for (prev = NULL, req = ata_queue; req != NULL && req->lba < ata_head_lba; prev = req, req = req->next);
+        if (req == NULL){
+            prev = NULL;
+            req = ata_queue;
+        }
+        if (prev != NULL)
+            prev->next = req->next;
+        else
+            ata_queue = req->next;
+        req->next = NULL;
+
+        ata_active = ata_seg = req;
+        ata_seg_sector = 0;
+        ata_sectors_left = req->chain_sectors;
+        ata_head_lba = req->lba + req->chain_sectors;
+        ata_stats.nbr_commands++;
+
+        outb(ATA_DRIVE_LBA | ATA_DRIVE_BIT(req->drive) | ((req->lba >> 24) & 0x0F), ATA_DRIVE_PORT);
+        ata_delay();    // (the drive selected may have changed)
+        outb(req->chain_sectors & 0xFF, ATA_COUNT_PORT);
+        outb(req->lba & 0xFF, ATA_LBA_LOW_PORT);
+        outb((req->lba >> 8) & 0xFF, ATA_LBA_MID_PORT);
+        outb((req->lba >> 16) & 0xFF, ATA_LBA_HIGH_PORT);
+        outb(req->write ? ATA_CMD_WRITE_SECTORS : ATA_CMD_READ_SECTORS, ATA_COMMAND_PORT);
+        if (req->write){    // the drive asks for the first sector without an interrupt
+            ata_delay();
+            if (ata_wait_ready(1) & (ATA_SR_BSY | ATA_SR_ERR | ATA_SR_DF))
+                ata_complete(ATA_REQ_ERROR);    // (and try the next command)
+            else
+                ata_next_sector();
+        }
+    }
+}
+
+/*
+ * ata_service
+ *   DESCRIPTION: moves the active command on after the drive signaled (interrupt, or polled status): reads the
+ *                sector it has, gives it the next sector to write, or completes the command
+ *   INPUTS: status: status read from the drive
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: transfers a sector, may complete the command and start the next one
+ *   RETURN VALUE: none
+ */
+static void ata_service(uint32_t status){
+    if (ata_active == NULL || (status & ATA_SR_BSY))
+        return;     // nothing to do (interrupt of a command already served by polling)
+    if (status & (ATA_SR_ERR | ATA_SR_DF)){
+        ata_complete(ATA_REQ_ERROR);
+    }
+    else if (ata_sectors_left > 0){
+        if (!(status & ATA_SR_DRQ))
+            return;
+        ata_next_sector();
+        if (ata_sectors_left > 0 || ata_active->write)
+            return;     // a write completes on the interrupt after its last sector
+        ata_complete(ATA_REQ_DONE);
+    }
+    else
+        ata_complete(ATA_REQ_DONE);
+    ata_start();
+}
+
+/*
+ * ata_inter_handler
+ *   DESCRIPTION: interrupt handler of the drive (IRQ 14), called by the IDT entry through asm linkage: the drive
+ *                has a sector to read, wants the next sector to write, or is done
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: reading the status acknowledges the interrupt, see ata_service
+ *   RETURN VALUE: none
+ */
+void ata_inter_handler(void){
+    ata_service(inb(ATA_STATUS_PORT));
+    send_eoi(ATA_IRQ_PIN);
+}
+
+/*
+ * ata_identify
+ *   DESCRIPTION: asks a drive of the primary channel for its size with IDENTIFY (polled)
+ *                (aknowledgement: wiki.osdev.org/ATA_PIO_Mode)
+ *   INPUTS: drive: 0 = master, 1 = slave
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: selects the drive
+ *   RETURN VALUE: nbr of LBA28 sectors of the drive, 0 if it is not an ATA drive
+ */
+static uint32_t ata_identify(uint32_t drive){
+    uint16_t ident[ATA_SECTOR_WORDS];
+    uint32_t sectors;
+
+    outb(ATA_DRIVE_SELECT | ATA_DRIVE_BIT(drive), ATA_DRIVE_PORT);
+    ata_delay();
+    if (inb(ATA_STATUS_PORT) == ATA_SR_FLOATING)
+        return 0;   // no controller
+    outb(0, ATA_COUNT_PORT);
+    outb(0, ATA_LBA_LOW_PORT);
+    outb(0, ATA_LBA_MID_PORT);
+    outb(0, ATA_LBA_HIGH_PORT);
+    outb(ATA_CMD_IDENTIFY, ATA_COMMAND_PORT);
+    ata_delay();
+    if (inb(ATA_STATUS_PORT) == 0)
+        return 0;   // no drive
+    if (ata_wait_ready(0) & ATA_SR_BSY)
+        return 0;
+    if (inb(ATA_LBA_MID_PORT) != 0 || inb(ATA_LBA_HIGH_PORT) != 0)
+        return 0;   // not an ATA drive (ATAPI, SATA)
+    if (ata_wait_ready(1) & (ATA_SR_BSY | ATA_SR_ERR | ATA_SR_DF))
+        return 0;
+    ata_pio_in((uint8_t*)ident);
+    sectors = ident[ATA_IDENT_LBA28_SECTORS] | ((uint32_t)ident[ATA_IDENT_LBA28_SECTORS + 1] << 16);
+    return (sectors > ATA_LBA28_MAX) ? ATA_LBA28_MAX : sectors;
+}
+
+/*
+ * ata_init
+ *   DESCRIPTION: detects the drives of the primary channel and enables their interrupt if there is one
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: ata_nbr_sectors gives 0 for a drive that is not there
+ *   RETURN VALUE: none
+ */
+void ata_init(void){
+    uint32_t drive, found = 0;
+
+    for (drive = 0; drive < ATA_NBR_DRIVES; drive++)
+        found |= (ata_sectors[drive] = ata_identify(drive));
+    if (!found)
+        return;
+    outb(0, ATA_CTRL_PORT);     // drive interrupts on
+    enable_irq(ATA_IRQ_PIN);
+}
+
+/*
+ * ata_nbr_sectors
+ *   DESCRIPTION: gives the size of a drive
+ *   INPUTS: drive: 0 = master, 1 = slave
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: nbr of sectors (0: no drive)
+ */
+uint32_t ata_nbr_sectors(uint32_t drive){
+    return (drive < ATA_NBR_DRIVES) ? ata_sectors[drive] : 0;
+}
+
+/*
+ * ata_queue_insert
+ *   DESCRIPTION: puts a request in a queue of commands sorted by lba: it joins the command just before or after
+ *                it if they are on the same drive, in the same direction and fit in ATA_MAX_SECTORS together
+ *                (back merge after the command before, else front merge taking the place of the command after)
+ *   INPUTS: queue: head of the queue (ata_queue, or a queue of the tests) -- req: checked request
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: sets the driver fields of the request (pending), modifies the queue
+ *   RETURN VALUE: 1 (merged into the command of another request) or 0 (new command)
+ */
+uint32_t ata_queue_insert(ata_request_t** queue, ata_request_t* req){
+    ata_request_t* prev;
+    ata_request_t* cur;
+
+    req->status = ATA_REQ_PENDING;
+    req->next = req->chain_next = NULL;
+    req->chain_tail = req;
+    req->chain_sectors = req->nbr_sectors;
+
+    for (prev = NULL, cur = *queue; cur != NULL && cur->lba < req->lba; prev = cur, cur = cur->next);
+    if (prev != NULL && prev->drive == req->drive && prev->write == req->write && prev->lba + prev->chain_sectors == req->lba &&
+        prev->chain_sectors + req->nbr_sectors <= ATA_MAX_SECTORS){            // back merge: after prev
+        prev->chain_tail->chain_next = req;
+        prev->chain_tail = req;
+        prev->chain_sectors += req->nbr_sectors;
+        return 1;
+    }
+    if (cur != NULL && cur->drive == req->drive && cur->write == req->write && req->lba + req->nbr_sectors == cur->lba &&
+        cur->chain_sectors + req->nbr_sectors <= ATA_MAX_SECTORS){             // front merge: takes the place of cur
+        req->chain_next = cur;
+        req->chain_tail = cur->chain_tail;
+        req->chain_sectors += cur->chain_sectors;
+        req->next = cur->next;
+        cur->next = NULL;
+    }
+    else
+        req->next = cur;
+    if (prev != NULL)
+        prev->next = req;
+    else
+        *queue = req;
+    return (req->chain_next != NULL);
+}
+
+/*
+ * ata_submit
+ *   DESCRIPTION: queues a request and returns at once, the request is completed by the interrupt handler (see
+ *                ata_wait). a request for the sectors just before or after a queued command in the same direction
+ *                joins that command (up to ATA_MAX_SECTORS). requests in the queue at the same time must not
+ *                overlap (they are not served in the order submitted)
+ *   INPUTS: req: request (drive, lba, nbr_sectors, buf, write, done, priv), not touched by the caller until completed
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may start the drive
+ *   RETURN VALUE: 0 (queued) or -1 (bad request or no drive)
+ */
+int32_t ata_submit(ata_request_t* req){
+    uint32_t flags;
+
+    if (req == NULL || req->buf == NULL || req->drive >= ATA_NBR_DRIVES || req->nbr_sectors == 0 ||
+        req->nbr_sectors > ATA_MAX_SECTORS || req->lba >= ata_sectors[req->drive] ||
+        req->nbr_sectors > ata_sectors[req->drive] - req->lba)
+        return -1;
+    cli_and_save(flags);
+    ata_stats.nbr_requests++;
+    ata_stats.nbr_merged += ata_queue_insert(&ata_queue, req);
+    ata_start();
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ * ata_wait
+ *   DESCRIPTION: waits for a request to complete: asleep (the other tasks run) if a task is running or interrupts
+ *                are on, else (kernel init) by polling the drive with its interrupt off
+ *   INPUTS: req: submitted request
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may switch tasks
+ *   RETURN VALUE: ATA_REQ_DONE or ATA_REQ_ERROR
+ */
+int32_t ata_wait(ata_request_t* req){
+    uint32_t flags, status;
+
+    cli_and_save(flags);
+    while (req->status == ATA_REQ_PENDING){
+        if (active_terminals.terminals[active_terminals.current_active_terminal].active_pcb != NULL || (flags & EFLAGS_IF)){
+            wait_queue_sleep(&ata_wait_queue);
+            continue;
+        }
+        if (ata_active == NULL)
+            ata_start();
+        if (req->status != ATA_REQ_PENDING || ata_active == NULL)
+            continue;   // failed in ata_start (write the drive did not take): nothing to poll
+        outb(ATA_CTRL_NIEN, ATA_CTRL_PORT);
+        ata_delay();
+        status = ata_wait_ready(!(ata_active->write && ata_sectors_left == 0));
+        if (status & ATA_SR_BSY){   // the drive does not answer: fails the command
+            ata_complete(ATA_REQ_ERROR);
+            ata_start();
+        }
+        else
+            ata_service(status);
+        outb(0, ATA_CTRL_PORT);
+    }
+    restore_flags(flags);
+    return req->status;
+}
+
+/*
+ * ata_rw
+ *   DESCRIPTION: reads or writes sectors and waits for the transfer
+ *   INPUTS: drive: 0 = master, 1 = slave -- lba: first sector -- nbr_sectors: (1 to ATA_MAX_SECTORS)
+ *           buf: buffer -- write: 1 = write, 0 = read
+ *   OUTPUTS: buf: filled (read)
+ *   SIDE EFFECTS: may switch tasks
+ *   RETURN VALUE: 0 (success) or -1 (failure)
+ */
+int32_t ata_rw(uint32_t drive, uint32_t lba, uint32_t nbr_sectors, uint8_t* buf, uint32_t write){
+    ata_request_t req;
+
+    req.drive = drive;
+    req.lba = lba;
+    req.nbr_sectors = nbr_sectors;
+    req.buf = buf;
+    req.write = write;
+    req.done = NULL;
+    req.priv = NULL;
+    if (ata_submit(&req) != 0)
+        return -1;
+    return (ata_wait(&req) == ATA_REQ_DONE) ? 0 : -1;
+}
+
+/*
+ * ata_get_stats
+ *   DESCRIPTION: gives the statistics of the driver
+ *   INPUTS: stats: struct to fill
+ *   OUTPUTS: stats: filled
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: none
+ */
+void ata_get_stats(ata_stats_t* stats){
+    uint32_t flags;
+    cli_and_save(flags);
+    *stats = ata_stats;
+    restore_flags(flags);
+}
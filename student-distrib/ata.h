@@ -0,0 +1,97 @@
+/* ata.h - Defines the ATA (IDE) disk driver: drives of the primary channel, PIO transfers driven by IRQ 14, with
+ *         an asynchronous request queue ordered by an elevator
+ * vim:ts=4 noexpandtab
+ */
+#ifndef ATA_H
+#define ATA_H
+
+#include "types.h"
+
+// primary channel
+#define ATA_IO_PORT             0x1F0
+#define ATA_DATA_PORT           (ATA_IO_PORT + 0)
+#define ATA_ERROR_PORT          (ATA_IO_PORT + 1)
+#define ATA_COUNT_PORT          (ATA_IO_PORT + 2)
+#define ATA_LBA_LOW_PORT        (ATA_IO_PORT + 3)
+#define ATA_LBA_MID_PORT        (ATA_IO_PORT + 4)
+#define ATA_LBA_HIGH_PORT       (ATA_IO_PORT + 5)
+#define ATA_DRIVE_PORT          (ATA_IO_PORT + 6)
+#define ATA_STATUS_PORT         (ATA_IO_PORT + 7)   // reading it acknowledges the interrupt
+#define ATA_COMMAND_PORT        (ATA_IO_PORT + 7)
+#define ATA_CTRL_PORT           0x3F6               // device control (write) / alternate status (read)
+#define ATA_IRQ_PIN             14
+
+// status register
+#define ATA_SR_ERR              0x01
+#define ATA_SR_DRQ              0x08
+#define ATA_SR_DF               0x20
+#define ATA_SR_BSY              0x80
+#define ATA_SR_FLOATING         0xFF                // no controller on the channel
+
+#define ATA_NBR_DRIVES          2                   // master (0) and slave (1)
+#define ATA_DRIVE_SELECT        0xA0                // | ATA_DRIVE_BIT(drive)
+#define ATA_DRIVE_LBA           0xE0                // LBA addressing (| ATA_DRIVE_BIT(drive) | bits 24-27 of the LBA)
+#define ATA_DRIVE_BIT(drive)    ((drive) << 4)
+#define ATA_CMD_READ_SECTORS    0x20
+#define ATA_CMD_WRITE_SECTORS   0x30
+#define ATA_CMD_IDENTIFY        0xEC
+
+#define ATA_SECTOR_SIZE         512
+#define ATA_SECTOR_WORDS        (ATA_SECTOR_SIZE / 2)
+#define ATA_IDENT_LBA28_SECTORS 60                  // words 60-61 of IDENTIFY data: nbr of LBA28 sectors
+#define ATA_LBA28_MAX           0x10000000
+#define ATA_MAX_SECTORS         128                 // max sectors of one command (requests are merged up to this)
+#define ATA_POLL_LIMIT          1000000             // status reads before a polled wait gives up
+#define ATA_CTRL_NIEN           0x02                // device control: drive interrupt off (polled transfers)
+#define EFLAGS_IF               0x200
+
+// status of a request
+#define ATA_REQ_DONE            0
+#define ATA_REQ_ERROR           (-1)
+#define ATA_REQ_PENDING         1
+
+/* ATA REQUEST: a transfer of sectors to or from a buffer, owned by the submitter until it completes. requests
+ * for sectors that follow each other in the same direction are merged into one command (a chain) */
+typedef struct ata_request {
+    uint32_t drive;             // 0: master, 1: slave
+    uint32_t lba;               // first sector
+    uint32_t nbr_sectors;       // (1 to ATA_MAX_SECTORS)
+    uint8_t* buf;               // nbr_sectors * ATA_SECTOR_SIZE bytes
+    uint32_t write;             // 1 = write to disk, 0 = read
+    volatile int32_t status;    // ATA_REQ_PENDING until completed: ATA_REQ_DONE or ATA_REQ_ERROR
+    void (*done)(struct ata_request* req);  // called on completion (in the interrupt handler) if not NULL
+    void* priv;                 // for the submitter (done callback)
+    // set by the driver
+    struct ata_request* next;         // in queue (head of chain only)
+    struct ata_request* chain_next;   // next request of the chain (its sectors follow)
+    struct ata_request* chain_tail;   // head of chain: last request of the chain
+    uint32_t chain_sectors;           // head of chain: nbr of sectors of the whole command
+} ata_request_t;
+
+/* ATA STATISTICS */
+typedef struct ata_stats {
+    uint32_t nbr_requests;      // requests submitted
+    uint32_t nbr_merged;        // of which merged into the command of another request
+    uint32_t nbr_commands;      // commands sent to the drive
+    uint32_t nbr_sectors;       // sectors transferred
+    uint32_t nbr_errors;        // commands failed
+} ata_stats_t;
+
+/* detects the drives of the primary channel (IDENTIFY) and enables their interrupt */
+void ata_init(void);
+/* returns the nbr of sectors of a drive (0: no drive) */
+uint32_t ata_nbr_sectors(uint32_t drive);
+/* puts a request in a queue sorted by lba, merged into a command it continues (returns 1 if merged) */
+uint32_t ata_queue_insert(ata_request_t** queue, ata_request_t* req);
+/* queues a request, returns at once (0) or -1 for a bad request */
+int32_t ata_submit(ata_request_t* req);
+/* waits for a request to complete, returns its status */
+int32_t ata_wait(ata_request_t* req);
+/* reads or writes sectors and waits for the transfer */
+int32_t ata_rw(uint32_t drive, uint32_t lba, uint32_t nbr_sectors, uint8_t* buf, uint32_t write);
+/* interrupt handler of the drive */
+void ata_inter_handler(void);
+/* gives the statistics of the driver */
+void ata_get_stats(ata_stats_t* stats);
+
+#endif /* ATA_H */
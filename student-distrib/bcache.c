@@ -0,0 +1,273 @@
+/* bcache.c - Defines the block cache of the disk: blocks of the filesystem image kept in frames, keyed by block
+ *            nbr, read from the ATA drive on a miss. reads are asynchronous: a block being read is in the cache
+ *            (its users wait for the read), and prefetched blocks are queued together so the drive merges them
+ * vim:ts=4 noexpandtab
+ */
+
+#include "bcache.h"
+#include "lib.h"
+#include "frame.h"
+#include "scheduler.h"
+
+static bcache_buf_t bcache_bufs[BCACHE_NBR_BUFS];
+static bcache_buf_t* bcache_hash[BCACHE_HASH_SIZE];
+static bcache_buf_t* bcache_lru_head = NULL;      // buffers holding a frame, most recently used first
+static bcache_buf_t* bcache_lru_tail = NULL;
+static uint32_t bcache_nbr_bufs = 0;              // buffers given a frame so far
+static uint32_t bcache_drive = 0;                 // drive of the filesystem image
+static wait_queue_t bcache_wait_queue = WAIT_QUEUE_INITIALIZER;   // tasks waiting for a free buffer
+static bcache_stats_t bcache_stats;
+
+/*
+ * bcache_lru_unlink
+ *   DESCRIPTION: removes a buffer from the lru list
+ *   INPUTS: buf: buffer in lru list
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: modifies list
+ *   RETURN VALUE: none
+ */
+static void bcache_lru_unlink(bcache_buf_t* buf){
+    if (buf->lru_prev != NULL)
+        buf->lru_prev->lru_next = buf->lru_next;
+    else
+        bcache_lru_head = buf->lru_next;
+    if (buf->lru_next != NULL)
+        buf->lru_next->lru_prev = buf->lru_prev;
+    else
+        bcache_lru_tail = buf->lru_prev;
+    buf->lru_prev = buf->lru_next = NULL;
+}
+
+/*
+ * bcache_lru_push
+ *   DESCRIPTION: links a buffer at the head of the lru list (most recently used)
+ *   INPUTS: buf: buffer not in lru list
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: modifies list
+ *   RETURN VALUE: none
+ */
+static void bcache_lru_push(bcache_buf_t* buf){
+    buf->lru_prev = NULL;
+    buf->lru_next = bcache_lru_head;
+    if (bcache_lru_head != NULL)
+        bcache_lru_head->lru_prev = buf;
+    else
+        bcache_lru_tail = buf;
+    bcache_lru_head = buf;
+}
+
+/*
+ * bcache_find
+ *   DESCRIPTION: finds the buffer holding (or reading) a block
+ *   INPUTS: blk_nbr: block nbr
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: pointer to buffer or NULL if the block is not cached
+ */
+static bcache_buf_t* bcache_find(uint32_t blk_nbr){
+    bcache_buf_t* buf;
+    for (buf = bcache_hash[blk_nbr & (BCACHE_HASH_SIZE - 1)]; buf != NULL; buf = buf->hash_next)
+        if (buf->blk_nbr == blk_nbr)
+            return buf;
+    return NULL;
+}
+
+/*
+ * bcache_hash_remove
+ *   DESCRIPTION: removes a buffer from its hash chain, it holds no block after
+ *   INPUTS: buf: buffer in hash chain
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: modifies hash chains
+ *   RETURN VALUE: none
+ */
+static void bcache_hash_remove(bcache_buf_t* buf){
+    bcache_buf_t** link;
+    for (link = &bcache_hash[buf->blk_nbr & (BCACHE_HASH_SIZE - 1)]; *link != buf; link = &(*link)->hash_next);
+    *link = buf->hash_next;
+    buf->hash_next = NULL;
+    buf->state = BCACHE_EMPTY;
+}
+
+/*
+ * bcache_evict
+ *   DESCRIPTION: gives a buffer to hold a new block: a buffer not used yet (its frame is allocated), else the
+ *                least recently used buffer nobody uses and not being read, which loses its block
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may allocate a frame, modifies hash chains
+ *   RETURN VALUE: pointer to buffer (empty, in no list) or NULL if every buffer is busy
+ */
+static bcache_buf_t* bcache_evict(void){
+    bcache_buf_t* buf;
+    uint32_t frame;
+
+    if (bcache_nbr_bufs < BCACHE_NBR_BUFS && (frame = frame_alloc()) != 0){
+        buf = &bcache_bufs[bcache_nbr_bufs++];
+        buf->data = (uint8_t*)frame;    // frames are identity mapped for the kernel
+        buf->state = BCACHE_EMPTY;
+        return buf;
+    }
+    for (buf = bcache_lru_tail; buf != NULL && (buf->ref_cnt != 0 || buf->state == BCACHE_READING); buf = buf->lru_prev);
+    if (buf == NULL)
+        return NULL;
+    bcache_lru_unlink(buf);
+    if (buf->state != BCACHE_EMPTY)
+        bcache_hash_remove(buf);
+    return buf;
+}
+
+/*
+ * bcache_read_done
+ *   DESCRIPTION: completion of the read of a block (called by the drive's interrupt handler)
+ *   INPUTS: req: read request of a buffer
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: the buffer holds its block, or none if the read failed
+ *   RETURN VALUE: none
+ */
+static void bcache_read_done(ata_request_t* req){
+    bcache_buf_t* buf = (bcache_buf_t*)req->priv;
+    if (req->status == ATA_REQ_DONE)
+        buf->state = BCACHE_VALID;
+    else
+        bcache_hash_remove(buf);
+    wait_queue_wake(&bcache_wait_queue);    // (the buffer can be evicted now)
+}
+
+/*
+ * bcache_read_start
+ *   DESCRIPTION: puts a block in a buffer and queues its read
+ *   INPUTS: buf: empty buffer in no list -- blk_nbr: block nbr
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: the buffer is in the cache (reading), or empty if the read could not be queued
+ *   RETURN VALUE: none
+ */
+static void bcache_read_start(bcache_buf_t* buf, uint32_t blk_nbr){
+    uint32_t slot = blk_nbr & (BCACHE_HASH_SIZE - 1);
+
+    buf->blk_nbr = blk_nbr;
+    buf->state = BCACHE_READING;
+    buf->hash_next = bcache_hash[slot];
+    bcache_hash[slot] = buf;
+    bcache_lru_push(buf);
+    buf->req.drive = bcache_drive;
+    buf->req.lba = blk_nbr * BCACHE_BLK_SECTORS;
+    buf->req.nbr_sectors = BCACHE_BLK_SECTORS;
+    buf->req.buf = buf->data;
+    buf->req.write = 0;
+    buf->req.done = bcache_read_done;
+    buf->req.priv = buf;
+    if (ata_submit(&buf->req) != 0)
+        bcache_hash_remove(buf);
+}
+
+/*
+ * bcache_init
+ *   DESCRIPTION: sets the drive holding the filesystem image (call before the first bcache_get)
+ *   INPUTS: drive: 0 = master, 1 = slave
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: none
+ */
+void bcache_init(uint32_t drive){
+    bcache_drive = drive;
+}
+
+/*
+ * bcache_get
+ *   DESCRIPTION: gives a buffer holding a block, read from the disk on a miss (waits for the read). the buffer
+ *                is not evicted until it is released with bcache_put
+ *   INPUTS: blk_nbr: block nbr
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may switch tasks while the block is read
+ *   RETURN VALUE: pointer to buffer or NULL (read failed)
+ */
+bcache_buf_t* bcache_get(uint32_t blk_nbr){
+    bcache_buf_t* buf;
+    uint32_t flags, miss = 0;
+
+    cli_and_save(flags);
+    while ((buf = bcache_find(blk_nbr)) == NULL){
+        if ((buf = bcache_evict()) != NULL){
+            bcache_read_start(buf, blk_nbr);
+            if (buf->state == BCACHE_EMPTY){    // not queued (block past the end of the disk)
+                restore_flags(flags);
+                return NULL;
+            }
+            miss = 1;
+            break;
+        }
+        wait_queue_sleep(&bcache_wait_queue);   // every buffer is busy
+    }
+    if (miss)
+        bcache_stats.nbr_misses++;
+    else
+        bcache_stats.nbr_hits++;
+    buf->ref_cnt++;
+    while (buf->state == BCACHE_READING)   // asleep until the drive's interrupt completes the read
+        ata_wait(&buf->req);
+    if (buf->state != BCACHE_VALID){
+        buf->ref_cnt--;
+        restore_flags(flags);
+        return NULL;
+    }
+    bcache_lru_unlink(buf);
+    bcache_lru_push(buf);
+    restore_flags(flags);
+    return buf;
+}
+
+/*
+ * bcache_put
+ *   DESCRIPTION: releases a buffer given by bcache_get (its data must not be used after)
+ *   INPUTS: buf: buffer (NULL is ignored)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: wakes the tasks waiting for a free buffer
+ *   RETURN VALUE: none
+ */
+void bcache_put(bcache_buf_t* buf){
+    uint32_t flags;
+
+    if (buf == NULL)
+        return;
+    cli_and_save(flags);
+    if (--buf->ref_cnt == 0)
+        wait_queue_wake(&bcache_wait_queue);
+    restore_flags(flags);
+}
+
+/*
+ * bcache_prefetch
+ *   DESCRIPTION: starts reading a block into the cache and returns at once (nothing is done if the block is
+ *                cached or every buffer is busy). reads prefetched together are merged by the drive's elevator
+ *   INPUTS: blk_nbr: block nbr
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may evict a block
+ *   RETURN VALUE: none
+ */
+void bcache_prefetch(uint32_t blk_nbr){
+    bcache_buf_t* buf;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (bcache_find(blk_nbr) == NULL && (buf = bcache_evict()) != NULL){
+        bcache_read_start(buf, blk_nbr);
+        if (buf->state == BCACHE_READING)
+            bcache_stats.nbr_prefetches++;
+    }
+    restore_flags(flags);
+}
+
+/*
+ * bcache_get_stats
+ *   DESCRIPTION: gives the statistics of the block cache
+ *   INPUTS: stats: struct to fill
+ *   OUTPUTS: stats: filled
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: none
+ */
+void bcache_get_stats(bcache_stats_t* stats){
+    uint32_t flags;
+    cli_and_save(flags);
+    *stats = bcache_stats;
+    restore_flags(flags);
+}
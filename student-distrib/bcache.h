@@ -0,0 +1,52 @@
+/* bcache.h - Defines the block cache of the disk: blocks of the filesystem image kept in frames, read from the
+ *            ATA drive on a miss
+ * vim:ts=4 noexpandtab
+ */
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "types.h"
+#include "ata.h"
+#include "filesystem.h"
+
+#define BCACHE_NBR_BUFS         32      // frames of disk blocks (allocated on first use)
+#define BCACHE_HASH_SIZE        64      // power of 2
+#define BCACHE_BLK_SECTORS      (FILESYSTEM_BLOCK_SIZE / ATA_SECTOR_SIZE)
+#define BCACHE_PREFETCH_MAX     (BCACHE_NBR_BUFS / 2)   // blocks a reader starts reading ahead of itself at most
+
+// state of a buffer
+#define BCACHE_EMPTY            0       // holds no block
+#define BCACHE_READING          1       // read of its block in flight (cannot be evicted)
+#define BCACHE_VALID            2       // holds its block
+
+/* BCACHE BUFFER: one block of the disk */
+typedef struct bcache_buf {
+    struct bcache_buf* hash_next;   // in hash chain of block nbr (reading or valid)
+    struct bcache_buf* lru_prev;    // in lru list (head: most recently used)
+    struct bcache_buf* lru_next;
+    uint32_t blk_nbr;               // block of the filesystem image (sector blk_nbr * BCACHE_BLK_SECTORS)
+    uint32_t state;
+    uint32_t ref_cnt;               // users of the data (a buffer in use is not evicted)
+    uint8_t* data;                  // frame holding the block
+    ata_request_t req;              // read of the block
+} bcache_buf_t;
+
+/* BCACHE STATISTICS */
+typedef struct bcache_stats {
+    uint32_t nbr_hits;          // blocks found in the cache (or being read)
+    uint32_t nbr_misses;        // blocks read from the disk by bcache_get
+    uint32_t nbr_prefetches;    // blocks read from the disk ahead of bcache_get
+} bcache_stats_t;
+
+/* sets the drive holding the filesystem image */
+void bcache_init(uint32_t drive);
+/* gives a buffer holding a block, read from the disk on a miss, in use until bcache_put (NULL: read failed) */
+bcache_buf_t* bcache_get(uint32_t blk_nbr);
+/* releases a buffer given by bcache_get */
+void bcache_put(bcache_buf_t* buf);
+/* starts reading a block into the cache, does not wait */
+void bcache_prefetch(uint32_t blk_nbr);
+/* gives the statistics of the block cache */
+void bcache_get_stats(bcache_stats_t* stats);
+
+#endif /* BCACHE_H */
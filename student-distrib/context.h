@@ -0,0 +1,45 @@
+/* context.h - Defines the saved context of a task, restored by switch_context
+ * vim:ts=4 noexpandtab
+ */
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+// offsets of the fields of context_t (used by context_switch.S)
+#define CTX_EBX             0
+#define CTX_ESI             4
+#define CTX_EDI             8
+#define CTX_EBP             12
+#define CTX_ESP             16
+#define CTX_EFLAGS          20
+#define CTX_EIP             24
+#define CTX_FPU_USED        28
+#define CTX_FPU_STATE       32
+
+#define CONTEXT_EFLAGS_INIT 0x00000002  // eflags of a new context: reserved bit 1 set, interrupts off
+#define FPU_STATE_SIZE      512         // fxsave area (x87 and sse registers), the fnsave area fits in it
+#define FPU_STATE_ALIGN     16          // fxsave area must be aligned to 16 bytes
+
+#ifndef ASM
+
+#include "types.h"
+
+/* CONTEXT: kernel state of a task suspended in switch_context (callee-saved registers, stack, resume point),
+   and its fpu state, saved lazily when another task uses the fpu (see fpu.c) */
+typedef struct context {
+    uint32_t ebx;               // callee-saved registers
+    uint32_t esi;
+    uint32_t edi;
+    uint32_t ebp;
+    uint32_t esp;               // kernel stack pointer to resume with
+    uint32_t eflags;
+    uint32_t eip;               // where the task resumes (return address of switch_context, or entry point)
+    uint32_t fpu_used;          // task has used the fpu: fpu_state (or the fpu itself) holds its registers
+    uint8_t  fpu_state[FPU_STATE_SIZE] __attribute__((aligned(FPU_STATE_ALIGN)));
+} context_t;
+
+/* saves the running task in prev (NULL: nothing saved) and resumes the task saved in next */
+extern void switch_context(context_t* prev, context_t* next);
+
+#endif /* ASM */
+
+#endif /* CONTEXT_H */
@@ -5,28 +5,220 @@
 #include "filesystem.h"
 #include "syscall_handlers.h"
 #include "terminal.h"
+#include "page_cache.h"
+#include "bcache.h"
 
 //define pointers that map filesystem structs to their corresponding memory location in the given filesystem memory region
-boot_blk_t* boot_blk_addr;  //address of boot block (first block in filesystem memory)
+boot_blk_t* boot_blk_addr;  //address of boot block (first block in filesystem memory, or copy of the one on disk)
 dentry_t* dentry_arr_addr ; 
-inode_blk_t* inodes_arr_addr;  //address of first inode in memory
-uint8_t* datablks_arr_addr; //address of first byte of first data block
+
+// image on the ATA disk (read through the block cache) instead of the boot module
+static uint32_t fs_on_disk = 0;
+static boot_blk_t fs_disk_boot_blk;
 
 uint8_t exe_magic_nbrs[NBR_EXE_MAGIC_NBRS] = {EXE_MAGIC_1, EXE_MAGIC_2, EXE_MAGIC_3, EXE_MAGIC_4}; // ELF magic number found in first 4 bytes of exe file
 
+// open-addressed (linear probing) index: filename hash -> index into dentries arr of boot block
+static int16_t dentry_hash_tbl[DENTRY_HASH_TBL_SIZE];
+// per-inode metadata: filetype and length of every inode referenced by the directory
+static inode_meta_t inode_meta_tbl[MAX_NBR_INODES];
+// exec metadata cache: validated magic, entry point and image length by inode number
+static exe_meta_t exe_meta_tbl[MAX_NBR_INODES];
+// bumped every time the directory changes, invalidates every exe_meta_tbl entry
+static uint32_t fs_generation = 0;
+
+/*
+ * filename_hash
+ *   DESCRIPTION: FNV-1a hash of a filename of up to MAX_FILENAME_LEN characters (stops at first NUL byte)
+ *   INPUTS: fname: pointer to file name -- len: max number of characters to hash
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: slot of the dentry hash table the name hashes to
+ */
+static uint32_t filename_hash(const uint8_t* fname, uint32_t len){
+    uint32_t hash = FNV_OFFSET_BASIS;
+    uint32_t i;
+    for (i = 0; i < len && fname[i] != '\0'; i++){
+        hash ^= fname[i];
+        hash *= FNV_PRIME;
+    }
+    return hash & (DENTRY_HASH_TBL_SIZE - 1);
+}
+
+/*
+ * fs_block_get
+ *   DESCRIPTION: gives a block of the filesystem image: in the boot module, or in the block cache of the disk
+ *   INPUTS: blk_nbr: block of the image (0: boot block, 1 + i: inode i, 1 + nbr_inodes + d: data block d)
+ *           buf: filled with the block cache buffer to release with fs_block_put (NULL for the boot module)
+ *   OUTPUTS: buf
+ *   SIDE EFFECTS: may wait for the disk
+ *   RETURN VALUE: pointer to the block or NULL (disk read failed)
+ */
+static uint8_t* fs_block_get(uint32_t blk_nbr, bcache_buf_t** buf){
+    *buf = NULL;
+    if (!fs_on_disk)
+        return (uint8_t*)boot_blk_addr + blk_nbr * FILESYSTEM_BLOCK_SIZE;
+    if ((*buf = bcache_get(blk_nbr)) == NULL)
+        return NULL;
+    return (*buf)->data;
+}
+
+/*
+ * fs_block_put
+ *   DESCRIPTION: releases a block given by fs_block_get
+ *   INPUTS: buf: block cache buffer of the block (NULL for the boot module)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: none
+ */
+static void fs_block_put(bcache_buf_t* buf){
+    bcache_put(buf);
+}
+
+/*
+ * fs_inode_len
+ *   DESCRIPTION: reads the length of a file from its inode block
+ *   INPUTS: inode: inode number (checked by caller)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may wait for the disk
+ *   RETURN VALUE: length in bytes or -1 (disk read failed)
+ */
+static int32_t fs_inode_len(uint32_t inode){
+    bcache_buf_t* buf;
+    inode_blk_t* inode_blk = (inode_blk_t*)fs_block_get(1 + inode, &buf);
+    int32_t len;
+    if (inode_blk == NULL)
+        return -1;
+    len = inode_blk->file_len_inB;
+    fs_block_put(buf);
+    return len;
+}
+
+/*
+ * fs_mount_disk
+ *   DESCRIPTION: looks for a filesystem image at the start of an ATA drive (the boot disk is usually the master,
+ *                so the slave is tried first): its boot block is copied to memory if it starts with the "."
+ *                directory and the image it describes fits in the drive
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: sets boot_blk_addr to the copy of the boot block, the block cache reads from the drive found
+ *   RETURN VALUE: 0 (image found) or -1 (no drive holds an image)
+ */
+static int32_t fs_mount_disk(void){
+    uint32_t drive, nbr_blocks;
+
+    for (drive = ATA_NBR_DRIVES; drive-- > 0; ){
+        if (ata_nbr_sectors(drive) < BCACHE_BLK_SECTORS ||
+            ata_rw(drive, 0, BCACHE_BLK_SECTORS, (uint8_t*)&fs_disk_boot_blk, 0) != 0)
+            continue;
+        if (fs_disk_boot_blk.nbr_dir_entries <= 0 || fs_disk_boot_blk.nbr_dir_entries > NBR_DENTRIES_IN_BOOTBLOCK ||
+            fs_disk_boot_blk.nbr_inodes <= 0 || fs_disk_boot_blk.nbr_data_blocks < 0 ||
+            strncmp((int8_t*)fs_disk_boot_blk.dir_entries[0].filename, ".", 2) != 0 ||
+            fs_disk_boot_blk.dir_entries[0].filetype != DIRECTORY_FILE_TYPE)
+            continue;
+        nbr_blocks = 1 + (uint32_t)fs_disk_boot_blk.nbr_inodes + (uint32_t)fs_disk_boot_blk.nbr_data_blocks;
+        if (nbr_blocks > ata_nbr_sectors(drive) / BCACHE_BLK_SECTORS)
+            continue;
+        bcache_init(drive);
+        boot_blk_addr = &fs_disk_boot_blk;
+        fs_on_disk = 1;
+        return 0;
+    }
+    return -1;
+}
+
 /*
  * filesystem_init
- *   DESCRIPTION: initializes the file system structures (set pointers to correct memory addresses of inside file system allocated memory)
+ *   DESCRIPTION: initializes the file system structures (set pointers to correct memory addresses of inside file system allocated memory).
+ *                an image on the ATA disk is used rather than the boot module (it is not bounded by boot memory)
  *   INPUTS: filesystem_base_addr: starting address of pre_filled memory space for filesystem structs
  *   OUTPUTS: none
- *   SIDE EFFECTS: none
+ *   SIDE EFFECTS: reads the disk (call after ata_init and frame_init)
  *   RETURN VALUE: none
  */
 void filesystem_init(int32_t* filesystem_base_addr){
- boot_blk_addr = (boot_blk_t*)(*filesystem_base_addr) ; // fs base address is retrieved and defined as var in kernel.c
+ if (fs_mount_disk() != 0)
+     boot_blk_addr = (boot_blk_t*)(*filesystem_base_addr) ; // fs base address is retrieved and defined as var in kernel.c
  dentry_arr_addr = (dentry_t*)(boot_blk_addr-> dir_entries); // index 0 of dentries array of boot block
- inodes_arr_addr = (inode_blk_t*)(boot_blk_addr + 1); // inode is the second block in filesystem memory 
- datablks_arr_addr = (uint8_t*)(inodes_arr_addr + boot_blk_addr->nbr_inodes);  // first data block comes after nbr_inodes 
+ filesystem_rebuild_dentry_index(); // build name index once so lookups by name don't scan the directory
+}
+
+/*
+ * filesystem_on_disk
+ *   DESCRIPTION: tells where the filesystem image is read from
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: 1 (ATA disk, through the block cache) or 0 (boot module)
+ */
+uint32_t filesystem_on_disk(void){
+    return fs_on_disk;
+}
+
+/*
+ * prefetch_blocks
+ *   DESCRIPTION: starts reading data blocks of a file from the disk, without waiting (nothing to do for the boot
+ *                module): the reads are queued together so the drive merges them
+ *   INPUTS: inode: inode number of file -- blk_index: index of first block in file -- nbr_blks: nbr of blocks
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: fills the block cache
+ *   RETURN VALUE: none
+ */
+void prefetch_blocks(uint32_t inode, uint32_t blk_index, uint32_t nbr_blks){
+    bcache_buf_t* buf;
+    inode_blk_t* inode_blk;
+    uint32_t datablk_i, last;
+
+    if (!fs_on_disk || inode >= boot_blk_addr->nbr_inodes || (inode_blk = (inode_blk_t*)fs_block_get(1 + inode, &buf)) == NULL)
+        return;
+    if (nbr_blks > BCACHE_PREFETCH_MAX)
+        nbr_blks = BCACHE_PREFETCH_MAX;
+    last = blk_index + nbr_blks;
+    for (; blk_index < last && blk_index < MAX_NUM_DATA_BLOCKS && blk_index * FILESYSTEM_BLOCK_SIZE < (uint32_t)inode_blk->file_len_inB; blk_index++){
+        datablk_i = (uint32_t)inode_blk->data_block_num[blk_index];
+        if (datablk_i < boot_blk_addr->nbr_data_blocks)
+            bcache_prefetch(1 + boot_blk_addr->nbr_inodes + datablk_i);
+    }
+    fs_block_put(buf);
+}
+
+/*
+ * filesystem_rebuild_dentry_index
+ *   DESCRIPTION: (re)builds the hash table mapping filenames to their index in dentries arr of boot block
+ *                and the per-inode metadata table (filetype and length by inode number).
+ *                must be called whenever the directory (dentries arr of boot block) changes
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: overwrites dentry_hash_tbl and inode_meta_tbl, invalidates exec metadata cache
+ *   RETURN VALUE: none
+ */
+void filesystem_rebuild_dentry_index(void){
+    uint32_t slot, dentry_i, inode_i;
+    uint32_t nbr_dentries_present = boot_blk_addr->nbr_dir_entries; // nbr of directory entries
+    if (nbr_dentries_present > NBR_DENTRIES_IN_BOOTBLOCK)
+        nbr_dentries_present = NBR_DENTRIES_IN_BOOTBLOCK;
+
+    fs_generation++; // cached exec metadata was derived from the old directory
+
+    for (slot = 0; slot < DENTRY_HASH_TBL_SIZE; slot++)
+        dentry_hash_tbl[slot] = DENTRY_HASH_EMPTY;
+
+    for (inode_i = 0; inode_i < MAX_NBR_INODES && inode_i < boot_blk_addr->nbr_inodes; inode_i++){
+        inode_meta_tbl[inode_i].filetype = INODE_TYPE_UNKNOWN;
+        inode_meta_tbl[inode_i].file_len_inB = fs_inode_len(inode_i);
+    }
+
+    for (dentry_i = 0; dentry_i < nbr_dentries_present; dentry_i++){
+        slot = filename_hash(dentry_arr_addr[dentry_i].filename, MAX_FILENAME_LEN);
+        while (dentry_hash_tbl[slot] != DENTRY_HASH_EMPTY)   // linear probing: table is never full (size > max nbr of dentries)
+            slot = (slot + 1) & (DENTRY_HASH_TBL_SIZE - 1);
+        dentry_hash_tbl[slot] = (int16_t)dentry_i;
+
+        // first dentry referring to an inode gives its type (same result the old dentry scan returned)
+        inode_i = (uint32_t)dentry_arr_addr[dentry_i].inode_num;
+        if (inode_i < MAX_NBR_INODES && inode_i < boot_blk_addr->nbr_inodes && inode_meta_tbl[inode_i].filetype == INODE_TYPE_UNKNOWN)
+            inode_meta_tbl[inode_i].filetype = dentry_arr_addr[dentry_i].filetype;
+    }
 }
 
 
@@ -49,25 +241,18 @@ uint32_t fname_len =  strlen((int8_t*) fname) ;
 if ( fname_len > MAX_FILENAME_LEN) //fname provided exceeds allowed filename length
      return -1;
 
+uint32_t slot = filename_hash(fname, fname_len); // start probing at the slot fname hashes to
 uint32_t dentry_i; // index of dentries array in boot block 
-uint32_t zero_pad_i;
-uint32_t nbr_dentries_present = boot_blk_addr->nbr_dir_entries; // nbr of directory entries
-uint8_t found =0;
-for (dentry_i = 0; dentry_i < nbr_dentries_present; dentry_i ++){
-
-   if( !(strncmp((int8_t*) fname, (int8_t*)dentry_arr_addr[dentry_i].filename, fname_len))){  //if fname matches with filename in dentry
-   found =1;
-   //check is filename is zero padded after "fname_len" of characters to confirm that fname matches with filename
-   for (zero_pad_i = fname_len; zero_pad_i <MAX_FILENAME_LEN; zero_pad_i++ ){
-        if (dentry_arr_addr[dentry_i].filename[zero_pad_i] != '\0'){
-            found =0;
-            break; 
-        }
-   } }
-   if (found){
+while (dentry_hash_tbl[slot] != DENTRY_HASH_EMPTY){
+   dentry_i = (uint32_t)dentry_hash_tbl[slot];
+   //fname matches if its characters match and the filename in dentry is zero padded (or full) after "fname_len" characters
+   if( !(strncmp((int8_t*) fname, (int8_t*)dentry_arr_addr[dentry_i].filename, fname_len)) &&
+       (fname_len == MAX_FILENAME_LEN || dentry_arr_addr[dentry_i].filename[fname_len] == '\0')){
        if (!read_dentry_by_index(dentry_i, dentry)) 
              return 0;   // only return 0 if read was succesfull 
+       return -1;
    }
+   slot = (slot + 1) & (DENTRY_HASH_TBL_SIZE - 1); // go to next slot of probe chain
 }
 return -1; //failure: filename not found in directory or no copy was successful
 }
@@ -104,56 +289,111 @@ int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry){
  *   INPUTS: inode: inode number of file to be read -- offset: offset position in file to start reading from 
  *   -- buf: pointer to buffer to be filled with bytes read -- length: number of bytes requested to be read
  *   OUTPUTS: buf: pointer to buffer to be filled with bytes read
- *   SIDE EFFECTS: none
+ *   SIDE EFFECTS: may wait for the disk
  *   RETURN VALUE: -1: fail or number of bytes read (0 means that end of file is reached or no reading is done)
  */
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+    bcache_buf_t* inode_buf;
+    bcache_buf_t* blk_buf;
+    inode_blk_t* inode_blk;
+    uint8_t* blk;
+
     //sanity checks
     if( inode >= boot_blk_addr->nbr_inodes || buf == NULL )// inode num exceed max inode num
             return -1; 
+    if ((inode_blk = (inode_blk_t*)fs_block_get(1 + inode, &inode_buf)) == NULL)
+            return -1; // disk read failed
 
-    int32_t nbr_bytes_read = 0; 
-    int32_t file_length = inodes_arr_addr[inode].file_len_inB; //actual length of file described by inode
+    uint32_t file_length = inode_blk->file_len_inB; //actual length of file described by inode
     
-    if(offset > file_length) return 0;  //offset exceeds file length (nothing to be copied from file) 
+    if(offset >= file_length){  //offset reaches/exceeds file length (nothing to be copied from file) 
+        fs_block_put(inode_buf);
+        return 0;
+    }
     
-    int32_t* data_blocks_inode = inodes_arr_addr[inode].data_block_num; 
-    int32_t max_datablk_num = boot_blk_addr->nbr_data_blocks; // max valid data_block num
-    int32_t loop_i, buf_i =0; // index of buffer
-    int32_t blk_byte_off =  offset % FILESYSTEM_BLOCK_SIZE; //start copy from this byte offset of a certain block
-    int32_t curr_datablk_inode_i =  (offset - blk_byte_off) / FILESYSTEM_BLOCK_SIZE ; // first data block index in inode 
-    int32_t max_num_bytes_read = ((file_length - offset) > length)? length:  (file_length - offset);
+    int32_t* data_blocks_inode = inode_blk->data_block_num; 
+    uint32_t max_datablk_num = boot_blk_addr->nbr_data_blocks; // max valid data_block num
+    uint32_t blk_byte_off =  offset % FILESYSTEM_BLOCK_SIZE; //start copy from this byte offset of first block
+    uint32_t curr_datablk_inode_i =  offset / FILESYSTEM_BLOCK_SIZE ; // first data block index in inode 
+    uint32_t max_num_bytes_read = ((file_length - offset) > length)? length:  (file_length - offset);
+    uint32_t nbr_bytes_read = 0; 
+    uint32_t run_len, span;   // nbr of physically contiguous blocks in current run -- bytes copied from that run
+    uint32_t curr_datablk_i;
+
+    //on disk: queue the reads of every block needed at once (the drive merges them), then copy as they arrive
+    if (fs_on_disk)
+        prefetch_blocks(inode, curr_datablk_inode_i, (blk_byte_off + max_num_bytes_read + FILESYSTEM_BLOCK_SIZE - 1) / FILESYSTEM_BLOCK_SIZE);
    
-   //start copy
-    while(1){
-            //do sanity checks on current data block read from 
-        if (curr_datablk_inode_i >= MAX_NUM_DATA_BLOCKS) return -1; // a bad data block index is encountered
-        int32_t curr_datablk_i = data_blocks_inode[curr_datablk_inode_i];
-        if (curr_datablk_i >= max_datablk_num) return -1; // a bad block is encountered
-        uint8_t* start_curr_datablk = datablks_arr_addr + curr_datablk_i * FILESYSTEM_BLOCK_SIZE; 
-
-        //copy all of curr data block if allowed
-        if( (nbr_bytes_read + FILESYSTEM_BLOCK_SIZE - blk_byte_off) <= max_num_bytes_read ){
-            for(loop_i = blk_byte_off ; loop_i< FILESYSTEM_BLOCK_SIZE; loop_i ++){
-                buf[buf_i++] =  *(start_curr_datablk + loop_i);
-            } 
-            nbr_bytes_read += FILESYSTEM_BLOCK_SIZE - blk_byte_off; 
-            blk_byte_off =0;
-            curr_datablk_inode_i++; //go to next data block in inode
-        }
-        else{ // we are copying from the final data block
-            for(loop_i = blk_byte_off; loop_i< (max_num_bytes_read + blk_byte_off- nbr_bytes_read); loop_i++){
-                buf[buf_i++] =  *(start_curr_datablk + loop_i );
-            }
-            nbr_bytes_read = max_num_bytes_read;  
-            break; 
+    //copy run by run: a run is a maximal sequence of data blocks that are also consecutive in filesystem memory
+    //(on disk every block is a run: blocks are in separate block cache buffers)
+    while(nbr_bytes_read < max_num_bytes_read){
+        //do sanity checks on first data block of run
+        if (curr_datablk_inode_i >= MAX_NUM_DATA_BLOCKS) break; // a bad data block index is encountered
+        curr_datablk_i = (uint32_t)data_blocks_inode[curr_datablk_inode_i];
+        if (curr_datablk_i >= max_datablk_num) break; // a bad block is encountered
+
+        //extend run while the bytes still needed go past its end and the next block directly follows it in memory
+        span = FILESYSTEM_BLOCK_SIZE - blk_byte_off;
+        run_len = 1;
+        while (!fs_on_disk && span < (max_num_bytes_read - nbr_bytes_read) &&
+               curr_datablk_inode_i + run_len < MAX_NUM_DATA_BLOCKS &&
+               (uint32_t)data_blocks_inode[curr_datablk_inode_i + run_len] == curr_datablk_i + run_len &&
+               curr_datablk_i + run_len < max_datablk_num){
+            span += FILESYSTEM_BLOCK_SIZE;
+            run_len++;
         }
-        //loop end
+        if (span > max_num_bytes_read - nbr_bytes_read) // partial tail of final block
+            span = max_num_bytes_read - nbr_bytes_read;
+
+        if ((blk = fs_block_get(1 + boot_blk_addr->nbr_inodes + curr_datablk_i, &blk_buf)) == NULL) break; // disk read failed
+        memcpy(buf + nbr_bytes_read, blk + blk_byte_off, span);
+        fs_block_put(blk_buf);
+        nbr_bytes_read += span;
+        blk_byte_off = 0;               // every run after the first starts at a block boundary
+        curr_datablk_inode_i += run_len; //go to first data block of next run
     }
 
+    fs_block_put(inode_buf);
+    if (nbr_bytes_read < max_num_bytes_read) // stopped at a bad block
+        return -1;
     return nbr_bytes_read;
 }
 
+/*
+ * read_block
+ *   DESCRIPTION: reads one data block of a file (the backing store of the page cache)
+ *   INPUTS: inode: inode number of file -- blk_index: index of the block in the file -- buf: block-sized buffer
+ *   OUTPUTS: buf: filled with the bytes of the block that are in the file
+ *   SIDE EFFECTS: may wait for the disk
+ *   RETURN VALUE: number of bytes of the file in the block (0 past the end of the file) or -1 (bad inode or block)
+ */
+int32_t read_block (uint32_t inode, uint32_t blk_index, uint8_t* buf){
+    bcache_buf_t* inode_buf;
+    bcache_buf_t* blk_buf;
+    inode_blk_t* inode_blk;
+    uint8_t* blk;
+    uint32_t file_length, datablk_i, len;
+
+    if (inode >= boot_blk_addr->nbr_inodes || buf == NULL || blk_index >= MAX_NUM_DATA_BLOCKS)
+        return -1;
+    if ((inode_blk = (inode_blk_t*)fs_block_get(1 + inode, &inode_buf)) == NULL)
+        return -1;
+    file_length = inode_blk->file_len_inB;
+    datablk_i = (uint32_t)inode_blk->data_block_num[blk_index];
+    fs_block_put(inode_buf);
+    if (blk_index * FILESYSTEM_BLOCK_SIZE >= file_length)
+        return 0;
+    if (datablk_i >= boot_blk_addr->nbr_data_blocks)
+        return -1; // a bad block is encountered
+    len = file_length - blk_index * FILESYSTEM_BLOCK_SIZE;
+    if (len > FILESYSTEM_BLOCK_SIZE)
+        len = FILESYSTEM_BLOCK_SIZE;
+    if ((blk = fs_block_get(1 + boot_blk_addr->nbr_inodes + datablk_i, &blk_buf)) == NULL)
+        return -1;
+    memcpy(buf, blk, len);
+    fs_block_put(blk_buf);
+    return len;
+}
 
 /* regular file functions : SUBJECT TO CHANGE AFTER ADDING FILE DESCIPTORS*/ 
 
@@ -187,7 +427,7 @@ int32_t close_file (int32_t fd){
           return -1;
      if (active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].flags == UNUSED)
          return -1; // file is not open
-     if (get_file_type_byinode_num(active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].inode_num) != REGULAR_FILE_TYPE)
+     if (active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].file_type != REGULAR_FILE_TYPE)
          return -1; // file type not matching
 
      active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].flags = UNUSED;
@@ -197,7 +437,7 @@ int32_t close_file (int32_t fd){
  * read_file
  *   DESCRIPTION:  read nbytes of data from file into the buf
  *   INPUTS: fd: file descriptor -- buf: pointer to buffer to be filled --  nbytes: num of bytes to be read
- *   SIDE EFFECTS: calls "read_data"
+ *   SIDE EFFECTS: calls "page_cache_read"
  *   RETURN VALUE: number of bytes read (success) or -1(failure)
  */
 int32_t read_file(int32_t fd, void* buf, int32_t nbytes){
@@ -205,10 +445,13 @@ int32_t read_file(int32_t fd, void* buf, int32_t nbytes){
           return -1;
      if (active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].flags == UNUSED)
          return -1; // file is not open
-     if (get_file_type_byinode_num(active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].inode_num) != REGULAR_FILE_TYPE)
+     if (active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].file_type != REGULAR_FILE_TYPE)
          return -1; // file type not matching
 
- int32_t nbrbytes_read = read_data(active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].inode_num, active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].file_position, buf, nbytes);
+ if (nbytes < 0)
+     return -1;
+ // through the page cache: the fd remembers the page of the last block read and reads sequential files ahead
+ int32_t nbrbytes_read = page_cache_read(&active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd], buf, nbytes);
  if(nbrbytes_read == -1)
       return -1;  //failed read 
 
@@ -259,7 +502,7 @@ int32_t close_dir(int32_t fd){
           return -1;
      if (active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].flags == UNUSED)
          return -1; // file is not open
-     if (get_file_type_byinode_num(active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].inode_num) != DIRECTORY_FILE_TYPE)
+     if (active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].file_type != DIRECTORY_FILE_TYPE)
          return -1; // file type not matching
              
      active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].flags = UNUSED;
@@ -339,7 +582,9 @@ int32_t get_file_type_bydentry_index(int32_t dentry_i){
 int32_t get_file_size_bydentry_index(int32_t dentry_i){
     if (dentry_i >= boot_blk_addr->nbr_dir_entries || dentry_i >= NBR_DENTRIES_IN_BOOTBLOCK)
         return -1; //fail if dentry index is invalid
-    return inodes_arr_addr[boot_blk_addr->dir_entries[dentry_i].inode_num].file_len_inB;
+    if (boot_blk_addr->dir_entries[dentry_i].inode_num < 0 || boot_blk_addr->dir_entries[dentry_i].inode_num >= boot_blk_addr->nbr_inodes)
+        return -1; //fail if inode num of dentry is invalid
+    return fs_inode_len(boot_blk_addr->dir_entries[dentry_i].inode_num);
 }
 
 /*
@@ -352,7 +597,9 @@ int32_t get_file_size_bydentry_index(int32_t dentry_i){
 int32_t get_file_size_byinode_num (int32_t inode_num){
     if (inode_num >= boot_blk_addr->nbr_inodes || inode_num < 0)
         return -1; //fail if inode_num is invalid
-    return inodes_arr_addr[inode_num].file_len_inB ;
+    if (inode_num < MAX_NBR_INODES)
+        return inode_meta_tbl[inode_num].file_len_inB;
+    return fs_inode_len(inode_num);
 }
 
 /*
@@ -365,7 +612,10 @@ int32_t get_file_size_byinode_num (int32_t inode_num){
 int32_t get_file_type_byinode_num (int32_t inode_number){
     if (inode_number >= boot_blk_addr->nbr_inodes || inode_number < 0)
         return -1; //fail if inode_num is invalid
+    if (inode_number < MAX_NBR_INODES)
+        return inode_meta_tbl[inode_number].filetype; // INODE_TYPE_UNKNOWN (-1) if no dentry refers to it
 
+    // inode beyond metadata table: fall back to scanning the directory
     uint32_t nbr_dentries_present = boot_blk_addr->nbr_dir_entries; // nbr of directory entries
     uint8_t dentry_i;
     for (dentry_i = 0; dentry_i < nbr_dentries_present; dentry_i ++){
@@ -390,24 +640,66 @@ int32_t get_file_type_byinode_num (int32_t inode_number){
 int8_t is_file_executable(uint8_t* filename){
 
     dentry_t exe_file_dentry; // holds dentry for file if it exists
+    exe_meta_t exe_info;      // holds validation result, entry point and length
+
+    return get_exe_info(filename, &exe_file_dentry, &exe_info);
+}
 
-    if ( read_dentry_by_name (filename , &exe_file_dentry)) 
+/*
+ * get_exe_info
+ *   DESCRIPTION: looks up a file by name and checks if it is executable. on the first call for an inode the header
+ *                (magic nbrs and entry point) is read from the file and the result is cached by inode number, later
+ *                calls are served from the cache unless the file length or the directory changed
+ *   INPUTS: filename: name of file -- dentry: dentry struct to be filled -- info: exec metadata struct to be filled
+ *   OUTPUTS: dentry: dentry of the file -- info: entry point and image length (valid when 0 is returned)
+ *   SIDE EFFECTS: fills exe_meta_tbl entry of the file's inode
+ *   RETURN VALUE: 0 (file is valid) 
+ *                 -1 (file is not present) 
+ *                 -2 (file present but not regular file)
+ *                 -3 (file is a regular file but not executable)                
+ */
+int8_t get_exe_info(const uint8_t* filename, dentry_t* dentry, exe_meta_t* info){
+
+    if (info == NULL || read_dentry_by_name (filename , dentry)) 
         return -1;  //-1: file is not even present
-    if (exe_file_dentry.filetype != REGULAR_FILE_TYPE)    
+    if (dentry->filetype != REGULAR_FILE_TYPE)    
         return -2;// -2: file present but not a regular file  
 
-    uint8_t magic_nbrs_buff[NBR_EXE_MAGIC_NBRS]; // this buffer will hold first 4 bytes read from file
-    //read first 4 bytes of the file
-    if( read_data (exe_file_dentry.inode_num, 0, magic_nbrs_buff, NBR_EXE_MAGIC_NBRS) != NBR_EXE_MAGIC_NBRS)
-        return -3; // -3: smthing went wrong but we know file is regular type
+    uint32_t inode = (uint32_t)dentry->inode_num;
+    int32_t live_len = fs_inode_len(inode); // from the inode block: the per-inode table only changes with the directory
+    if (live_len < 0)
+        return -3;  // -3: inode could not be read (smthing went wrong) but we know file is regular type
+    uint32_t file_len = (uint32_t)live_len;
+
+    // cache hit: entry filled for this inode, same directory and same file length 
+    if (inode < MAX_NBR_INODES && exe_meta_tbl[inode].valid &&
+        exe_meta_tbl[inode].fs_generation == fs_generation && exe_meta_tbl[inode].image_len == file_len){
+        *info = exe_meta_tbl[inode];
+        return info->status;
+    }
+
+    uint8_t header_buff[EIP_FILE_LOC + _4B]; // this buffer will hold magic nbrs (first 4 bytes) up to the entry point
+    info->valid = 1;
+    info->status = 0;
+    info->entry_point = 0;
+    info->image_len = file_len;
+    info->fs_generation = fs_generation;
+
+    //read header of the file: magic nbrs and entry point in one read
+    if( read_data (inode, 0, header_buff, EIP_FILE_LOC + _4B) != EIP_FILE_LOC + _4B)
+        info->status = -3; // -3: too short to be an executable (or smthing went wrong) but we know file is regular type
 
     //check if first 4 bytes read match magic nbrs identifying executable file
     uint8_t index; 
-    for (index =0; index <NBR_EXE_MAGIC_NBRS; index ++){
+    for (index =0; index <NBR_EXE_MAGIC_NBRS && info->status == 0; index ++){
 
-        if(magic_nbrs_buff[index] != exe_magic_nbrs[index])
-                return -3;  //-3: file is not executable
+        if(header_buff[index] != exe_magic_nbrs[index])
+                info->status = -3;  //-3: file is not executable
     }
+    if (info->status == 0)
+        info->entry_point = *(uint32_t*)(header_buff + EIP_FILE_LOC);
 
-    return 0; //all magic numbers match ==> file is executable
+    if (inode < MAX_NBR_INODES)
+        exe_meta_tbl[inode] = *info;  // negative results are cached too
+    return info->status;
 }
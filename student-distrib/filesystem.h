@@ -23,6 +23,14 @@
 #define EXE_MAGIC_3                    0x4C
 #define EXE_MAGIC_4                    0x46
 
+#define MAX_NBR_INODES                   1024      //nbr of inodes covered by the per-inode metadata table
+#define INODE_TYPE_UNKNOWN               (-1)      //inode not referenced by any dentry
+
+#define DENTRY_HASH_TBL_SIZE             128       //power of 2, at least twice NBR_DENTRIES_IN_BOOTBLOCK (keeps probe chains short)
+#define DENTRY_HASH_EMPTY                (-1)      //marks a free slot of the dentry name index
+#define FNV_OFFSET_BASIS                 0x811C9DC5
+#define FNV_PRIME                        0x01000193
+
 #include "types.h"
 //define structures used in the filesystem: dentry, boot block and inode 
 // NOTE: DATA BLOCKS DO NOT NEED A STRUCTURE BECAUSE THEY CAN BE FILLED WITH ANYTHIIING (IT IS UP TO USER PROGRAM TO INTERPRET CONTENT)
@@ -50,8 +58,25 @@ typedef struct __attribute__((packed)) inode_blk {
     int32_t data_block_num[MAX_NUM_DATA_BLOCKS];
 } inode_blk_t;
 
+/* PER-INODE METADATA (built from the directory at init, indexed by inode number) */
+typedef struct inode_meta {
+    int32_t filetype;      // type of first dentry referring to this inode or INODE_TYPE_UNKNOWN
+    int32_t file_len_inB;  // copy of file_len_inB of the inode block
+} inode_meta_t;
+
+/* EXEC METADATA (cached per inode on first exec, see get_exe_info) */
+typedef struct exe_meta {
+    uint8_t  valid;          // 1 if entry holds results for this inode
+    int8_t   status;         // validation result: 0 (executable) or -3 (regular file but not executable)
+    uint32_t entry_point;    // EIP read from EIP_FILE_LOC of the image
+    uint32_t image_len;      // file length when entry was filled (a different length invalidates the entry)
+    uint32_t fs_generation;  // filesystem generation when entry was filled (directory changes invalidate all entries)
+} exe_meta_t;
+
 /* this funciton initializes the file system structures*/ 
 void filesystem_init(int32_t* filesystem_base_addr);
+/* rebuilds the filename -> dentry index hash table and per-inode metadata table (call whenever the directory changes) */
+void filesystem_rebuild_dentry_index(void);
 
 /* necessary functions for the KERNEL to interface (so far, only read!) with the filesystem  */ 
 
@@ -62,6 +87,12 @@ int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry);
 /* reading up to length bytes starting from position offset in the file with inode number inode and 
  *   returning the number of bytes read and placed in the buffer */
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
+/* reads one data block of a file (backing store of the page cache), returns the nbr of bytes of the file in it */
+int32_t read_block (uint32_t inode, uint32_t blk_index, uint8_t* buf);
+/* starts reading data blocks of a file from the disk without waiting (image on the ATA disk only) */
+void prefetch_blocks(uint32_t inode, uint32_t blk_index, uint32_t nbr_blks);
+/* returns 1 if the image is read from the ATA disk (through the block cache), 0 for the boot module */
+uint32_t filesystem_on_disk(void);
 
 
 /* regular file functions */ 
@@ -100,5 +131,7 @@ int32_t get_file_size_byinode_num (int32_t inode_num);
 int32_t get_file_type_byinode_num (int32_t inode_number);
 /* FOR EXECUTE SYSTEM CALL: check if a requested file (by filename) is valid: present and executable */ 
 int8_t is_file_executable(uint8_t* filename); 
+/* FOR EXECUTE SYSTEM CALL: look up, validate and get entry point/length of an executable (cached per inode) */
+int8_t get_exe_info(const uint8_t* filename, dentry_t* dentry, exe_meta_t* info);
 
 #endif /* FILESYSTEM_H */
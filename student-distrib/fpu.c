@@ -0,0 +1,149 @@
+/* fpu.c - Defines the lazy switching of the fpu (x87 and sse registers) between tasks: the registers of the fpu
+ *         stay loaded until another task uses it (most tasks never do, and switches do not save or restore them)
+ * vim:ts=4 noexpandtab
+ */
+
+#include "fpu.h"
+#include "lib.h"
+
+static context_t* fpu_owner = NULL;    // task whose registers are in the fpu (NULL: none)
+static uint32_t fpu_fxsr = 0;          // cpu has fxsave/fxrstor: sse registers are saved too
+static uint8_t fpu_init_state[FPU_STATE_SIZE] __attribute__((aligned(FPU_STATE_ALIGN))); // registers of a first use
+
+/*
+ * fpu_save
+ *   DESCRIPTION: saves the fpu registers (fxsave, or fnsave without sse)
+ *   INPUTS: state - save area (aligned to 16 bytes)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: with fnsave the fpu is reinitialized
+ *   RETURN VALUE: none
+ */
+static void fpu_save(uint8_t* state){
+    if(fpu_fxsr)
+        asm volatile("fxsave (%0)" : : "r" (state) : "memory");
+    else
+        asm volatile("fnsave (%0)" : : "r" (state) : "memory");
+}
+
+/*
+ * fpu_restore
+ *   DESCRIPTION: loads the fpu registers saved by fpu_save
+ *   INPUTS: state - save area (aligned to 16 bytes)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: none
+ */
+static void fpu_restore(const uint8_t* state){
+    if(fpu_fxsr)
+        asm volatile("fxrstor (%0)" : : "r" (state) : "memory");
+    else
+        asm volatile("frstor (%0)" : : "r" (state) : "memory");
+}
+
+/*
+ * fpu_set_ts
+ *   DESCRIPTION: sets or clears the task switched bit of cr0
+ *   INPUTS: ts - 1: next fpu instruction traps, 0: the fpu is usable
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: writes cr0
+ *   RETURN VALUE: none
+ */
+static void fpu_set_ts(uint32_t ts){
+    uint32_t cr0;
+    if(!ts){
+        asm volatile("clts");
+        return;
+    }
+    asm volatile("movl %%cr0, %0" : "=r" (cr0));
+    asm volatile("movl %0, %%cr0" : : "r" (cr0 | CR0_TS));
+}
+
+/*
+ * fpu_init
+ *   DESCRIPTION: initializes the fpu (native error reporting, no emulation) and enables sse if the cpu has
+ *                fxsave/fxrstor, then keeps the initialized registers as those of a first use. no task owns
+ *                the fpu so the first fpu instruction of a task traps
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: writes cr0 and cr4
+ *   RETURN VALUE: none
+ */
+void fpu_init(void){
+    uint32_t cr0, cr4, eax, ebx, ecx, edx;
+    uint32_t mxcsr = MXCSR_DEFAULT;
+
+    asm volatile("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+    fpu_fxsr = (edx & CPUID_EDX_FXSR) != 0;
+    if(fpu_fxsr){
+        asm volatile("movl %%cr4, %0" : "=r" (cr4));
+        cr4 |= CR4_OSFXSR;
+        if(edx & CPUID_EDX_SSE)
+            cr4 |= CR4_OSXMMEXCPT;
+        asm volatile("movl %0, %%cr4" : : "r" (cr4));
+    }
+    asm volatile("movl %%cr0, %0" : "=r" (cr0));
+    cr0 = (cr0 | CR0_MP | CR0_NE) & ~(CR0_EM | CR0_TS);
+    asm volatile("movl %0, %%cr0 \n fninit" : : "r" (cr0));
+    if(edx & CPUID_EDX_SSE)
+        asm volatile("ldmxcsr %0" : : "m" (mxcsr));   // (xmm registers are 0 since reset)
+    fpu_save(fpu_init_state);
+    fpu_owner = NULL;
+    fpu_set_ts(1);
+}
+
+/*
+ * fpu_switch
+ *   DESCRIPTION: called when a task gets the cpu (the fpu registers are not switched): the fpu is usable
+ *                right away if the task owns it, otherwise its first fpu instruction traps (see fpu_trap)
+ *   INPUTS: next - context of the task getting the cpu (NULL: a task with no context yet)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: writes cr0
+ *   RETURN VALUE: none
+ */
+void fpu_switch(context_t* next){
+    fpu_set_ts(next == NULL || next != fpu_owner);
+}
+
+/*
+ * fpu_trap
+ *   DESCRIPTION: device not available trap (first fpu instruction of the running task since it got the cpu):
+ *                saves the registers (x87 and sse) of the owner of the fpu in its context and loads those of the
+ *                running task (initialized registers on its first use: nothing of another task shows), which becomes
+ *                the owner. called with interrupts off
+ *   INPUTS: current - context of the running task (NULL: no task yet, kernel tests)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: the faulting instruction is retried with the fpu usable
+ *   RETURN VALUE: none
+ */
+void fpu_trap(context_t* current){
+    fpu_set_ts(0);
+    if(current != NULL && current == fpu_owner)
+        return;
+    if(fpu_owner != NULL)
+        fpu_save(fpu_owner->fpu_state);
+    if(current != NULL && current->fpu_used)
+        fpu_restore(current->fpu_state);
+    else
+        fpu_restore(fpu_init_state);
+    if(current != NULL)
+        current->fpu_used = 1;
+    fpu_owner = current;
+}
+
+/*
+ * fpu_release
+ *   DESCRIPTION: forgets the fpu state of a task (exits, or its pid starts a new program): it has not used the
+ *                fpu, and owns it no more
+ *   INPUTS: context - context of the task
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: the fpu registers are left as they are (loaded again by the next use)
+ *   RETURN VALUE: none
+ */
+void fpu_release(context_t* context){
+    uint32_t flags;
+    cli_and_save(flags);
+    context->fpu_used = 0;
+    if(fpu_owner == context)
+        fpu_owner = NULL;
+    restore_flags(flags);
+}
@@ -0,0 +1,35 @@
+/* fpu.h - Defines the lazy switching of the fpu between tasks
+ * vim:ts=4 noexpandtab
+ */
+#ifndef FPU_H
+#define FPU_H
+
+#include "types.h"
+#include "context.h"
+
+// cr0 bits of the fpu
+#define CR0_MP      0x00000002  // monitor coprocessor: wait/fwait trap too while TS is set
+#define CR0_EM      0x00000004  // emulation: fpu instructions trap (cleared, the fpu is present)
+#define CR0_TS      0x00000008  // task switched: next fpu instruction traps (#NM)
+#define CR0_NE      0x00000020  // native fpu errors (#MF)
+
+// cr4 bits of sse
+#define CR4_OSFXSR      0x00000200  // fxsave/fxrstor save the sse registers, sse instructions enabled
+#define CR4_OSXMMEXCPT  0x00000400  // unmasked sse floating point errors raise #XF
+
+// cpuid (eax = 1) edx bits
+#define CPUID_EDX_FXSR  0x01000000  // fxsave/fxrstor
+#define CPUID_EDX_SSE   0x02000000
+
+#define MXCSR_DEFAULT   0x00001F80  // every sse floating point exception masked, round to nearest
+
+/* initializes the fpu (and sse if the cpu has it): no task owns it, the first fpu instruction traps */
+void fpu_init(void);
+/* called when a task gets the cpu: the fpu traps on its first use unless the task still owns it */
+void fpu_switch(context_t* next);
+/* device not available trap: gives the fpu to the running task (saves the owner's registers, loads the task's) */
+void fpu_trap(context_t* current);
+/* forgets the fpu state of a task that exits or starts a new program */
+void fpu_release(context_t* context);
+
+#endif /* FPU_H */
@@ -0,0 +1,234 @@
+/* frame.c - Defines the physical frame (4kB page) allocator
+ * vim:ts=4 noexpandtab
+ */
+
+#include "frame.h"
+#include "lib.h"
+
+static uint16_t frame_refcnts[NBR_FRAMES];   // references on each frame of the pool (0 = free)
+static uint16_t free_frames[NBR_FRAMES];     // stack of indices of free frames
+static uint32_t nbr_free_frames = 0;         // nbr of entries in free_frames stack
+static uint32_t pool_end = FRAME_POOL_START;  // end of highest frame of RAM
+
+/*
+ * frame_index
+ *   DESCRIPTION: converts a frame's physical address to its index in the pool
+ *   INPUTS: frame_addr: physical address of frame
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: index of frame or NBR_FRAMES if address is outside the pool
+ */
+static uint32_t frame_index(uint32_t frame_addr){
+    if (frame_addr < FRAME_POOL_START || frame_addr >= FRAME_POOL_MAX_END)
+        return NBR_FRAMES;
+    return (frame_addr - FRAME_POOL_START) >> FRAME_SHIFT;
+}
+
+/*
+ * frame_mark_range
+ *   DESCRIPTION: sets the reference count of the frames of the pool fully inside (RAM) or touching (reserved)
+ *                a physical address range
+ *   INPUTS: start, end: physical address range [start, end) -- refcnt: 0 (RAM) or FRAME_RESERVED
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: modifies reference counts
+ *   RETURN VALUE: none
+ */
+static void frame_mark_range(uint32_t start, uint32_t end, uint16_t refcnt){
+    uint32_t first, last, i;
+    if (end <= FRAME_POOL_START || start >= FRAME_POOL_MAX_END || end <= start)
+        return;
+    if (start < FRAME_POOL_START)
+        start = FRAME_POOL_START;
+    if (end > FRAME_POOL_MAX_END)
+        end = FRAME_POOL_MAX_END;
+    if (refcnt == 0){   // only whole frames of RAM are usable
+        first = (start - FRAME_POOL_START + FRAME_SIZE - 1) >> FRAME_SHIFT;
+        last = (end - FRAME_POOL_START) >> FRAME_SHIFT;
+    }
+    else{               // any frame touched is reserved
+        first = (start - FRAME_POOL_START) >> FRAME_SHIFT;
+        last = (end - FRAME_POOL_START + FRAME_SIZE - 1) >> FRAME_SHIFT;
+    }
+    for (i = first; i < last; i++)
+        frame_refcnts[i] = refcnt;
+}
+
+/*
+ * frame_init
+ *   DESCRIPTION: initializes the frame allocator from the multiboot info: frames of the pool that are available RAM
+ *                in the memory map (or below mem_upper if there is no map) are free, except those holding boot modules
+ *   INPUTS: mbi: multiboot info given by the boot loader (NULL: pool is empty)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: fills free frame stack (lowest addresses are handed out first)
+ *   RETURN VALUE: none
+ */
+void frame_init(const multiboot_info_t* mbi){
+    uint32_t i, end;
+    memory_map_t* mmap;
+    module_t* mod;
+
+    for (i = 0; i < NBR_FRAMES; i++)
+        frame_refcnts[i] = FRAME_RESERVED;
+    nbr_free_frames = 0;
+    pool_end = FRAME_POOL_START;
+    if (mbi == NULL)
+        return;
+
+    // RAM
+    if (mbi->flags & MBI_FLAG_MMAP){
+        for (mmap = (memory_map_t*)mbi->mmap_addr; (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+             mmap = (memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size))){
+            if (mmap->type != MMAP_TYPE_AVAILABLE || mmap->base_addr_high != 0)
+                continue;   // reserved, or above 4GB
+            end = mmap->base_addr_low + mmap->length_low;
+            if (mmap->length_high != 0 || end < mmap->base_addr_low)
+                end = FRAME_POOL_MAX_END;   // runs past 4GB
+            frame_mark_range(mmap->base_addr_low, end, 0);
+        }
+    }
+    else if (mbi->flags & MBI_FLAG_MEM)
+        frame_mark_range(MEM_UPPER_START, MEM_UPPER_START + mbi->mem_upper * 1024, 0);
+
+    // boot modules (filesystem image) stay where the boot loader put them
+    if (mbi->flags & MBI_FLAG_MODS){
+        for (i = 0, mod = (module_t*)mbi->mods_addr; i < mbi->mods_count; i++, mod++)
+            frame_mark_range(mod->mod_start, mod->mod_end, FRAME_RESERVED);
+    }
+
+    for (i = NBR_FRAMES; i > 0; i--){
+        if (frame_refcnts[i - 1] != 0)
+            continue;
+        free_frames[nbr_free_frames++] = (uint16_t)(i - 1);
+        if (pool_end == FRAME_POOL_START)
+            pool_end = FRAME_POOL_START + (i << FRAME_SHIFT);
+    }
+}
+
+/*
+ * frame_alloc
+ *   DESCRIPTION: allocates a frame in constant time, the caller holds the only reference on it
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: pops free frame stack
+ *   RETURN VALUE: physical address of frame or 0 if no frame is free
+ */
+uint32_t frame_alloc(void){
+    uint32_t flags, index;
+    cli_and_save(flags);
+    if (nbr_free_frames == 0){
+        restore_flags(flags);
+        return 0;
+    }
+    index = free_frames[--nbr_free_frames];
+    frame_refcnts[index] = 1;
+    restore_flags(flags);
+    return FRAME_POOL_START + (index << FRAME_SHIFT);
+}
+
+/*
+ * frame_alloc_contig
+ *   DESCRIPTION: allocates a run of physically contiguous frames aligned to the size of the run (eg. a kernel stack).
+ *                searches the pool for a free aligned run, so it is slower than frame_alloc: meant for rare allocations
+ *   INPUTS: nbr_frames: nbr of frames in the run (power of 2)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: removes the frames from the free frame stack, each frame must be released with frame_put
+ *   RETURN VALUE: physical address of first frame or 0 if no run is free
+ */
+uint32_t frame_alloc_contig(uint32_t nbr_frames){
+    uint32_t flags, index, i, j;
+    if (nbr_frames == 0 || (nbr_frames & (nbr_frames - 1)))
+        return 0;
+    cli_and_save(flags);
+    for (index = 0; index + nbr_frames <= NBR_FRAMES; index += nbr_frames){
+        for (i = 0; i < nbr_frames && frame_refcnts[index + i] == 0; i++);
+        if (i < nbr_frames)
+            continue;
+        // take run out of the free frame stack
+        for (i = 0; i < nbr_frames; i++){
+            frame_refcnts[index + i] = 1;
+            for (j = nbr_free_frames; j > 0; j--){
+                if (free_frames[j - 1] == index + i){
+                    free_frames[j - 1] = free_frames[--nbr_free_frames];
+                    break;
+                }
+            }
+        }
+        restore_flags(flags);
+        return FRAME_POOL_START + (index << FRAME_SHIFT);
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ * frame_get
+ *   DESCRIPTION: takes an extra reference on an allocated frame (eg. when it gets mapped in one more page table)
+ *   INPUTS: frame_addr: physical address of frame
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: increments reference count of frame
+ *   RETURN VALUE: none
+ */
+void frame_get(uint32_t frame_addr){
+    uint32_t index = frame_index(frame_addr);
+    if (index < NBR_FRAMES && frame_refcnts[index] != 0 && frame_refcnts[index] != FRAME_RESERVED)
+        frame_refcnts[index]++;
+}
+
+/*
+ * frame_put
+ *   DESCRIPTION: drops a reference on a frame, frees it when no reference is left
+ *   INPUTS: frame_addr: physical address of frame
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: decrements reference count of frame, may push it on free frame stack
+ *   RETURN VALUE: none
+ */
+void frame_put(uint32_t frame_addr){
+    uint32_t flags;
+    uint32_t index = frame_index(frame_addr);
+    if (index >= NBR_FRAMES || frame_refcnts[index] == 0 || frame_refcnts[index] == FRAME_RESERVED)
+        return;  // not an allocated frame of the pool
+    cli_and_save(flags);
+    if (--frame_refcnts[index] == 0)
+        free_frames[nbr_free_frames++] = (uint16_t)index;
+    restore_flags(flags);
+}
+
+/*
+ * frame_refcnt
+ *   DESCRIPTION: returns the number of references on a frame
+ *   INPUTS: frame_addr: physical address of frame
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: reference count (0 if frame is free, reserved or outside the pool)
+ */
+uint32_t frame_refcnt(uint32_t frame_addr){
+    uint32_t index = frame_index(frame_addr);
+    if (index >= NBR_FRAMES || frame_refcnts[index] == FRAME_RESERVED)
+        return 0;
+    return frame_refcnts[index];
+}
+
+/*
+ * frame_nbr_free
+ *   DESCRIPTION: returns the number of free frames
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: nbr of free frames in the pool
+ */
+uint32_t frame_nbr_free(void){
+    return nbr_free_frames;
+}
+
+/*
+ * frame_pool_end
+ *   DESCRIPTION: returns the end of the highest frame of RAM in the pool: [FRAME_POOL_START, frame_pool_end())
+ *                must be identity mapped for the kernel
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: physical address (FRAME_POOL_START if the pool is empty)
+ */
+uint32_t frame_pool_end(void){
+    return pool_end;
+}
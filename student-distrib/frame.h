@@ -0,0 +1,44 @@
+/* frame.h - Defines the physical frame (4kB page) allocator
+ * vim:ts=4 noexpandtab
+ */
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "types.h"
+#include "multiboot.h"
+
+// frames are handed out from the available RAM (multiboot memory map) between 8MB (end of kernel page) and 128MB
+// (start of user virtual region), the pool is identity mapped for the kernel so a frame's physical address is also
+// its kernel virtual address
+#define FRAME_POOL_START      0x800000
+#define FRAME_POOL_MAX_END    0x8000000
+#define FRAME_SIZE            4096
+#define FRAME_SHIFT           12
+#define NBR_FRAMES            ((FRAME_POOL_MAX_END - FRAME_POOL_START) / FRAME_SIZE)
+#define FRAME_RESERVED        0xFFFF       // reference count of a frame that is not RAM (or holds a boot module)
+
+// multiboot info flags and memory map entry type used to find the RAM
+#define MBI_FLAG_MEM          0x01
+#define MBI_FLAG_MODS         0x08
+#define MBI_FLAG_MMAP         0x40
+#define MMAP_TYPE_AVAILABLE   1
+#define MEM_UPPER_START       0x100000     // mem_upper counts KB of RAM from 1MB
+
+/* initializes the frame allocator: every frame of RAM given by the multiboot info is free (except boot modules) */
+void frame_init(const multiboot_info_t* mbi);
+/* allocates a frame (reference count 1), returns its physical address or 0 if none is free */
+uint32_t frame_alloc(void);
+/* allocates a run of physically contiguous frames aligned to its size (each with reference count 1) */
+uint32_t frame_alloc_contig(uint32_t nbr_frames);
+/* takes an extra reference on an allocated frame */
+void frame_get(uint32_t frame_addr);
+/* drops a reference on a frame, frees it when no reference is left */
+void frame_put(uint32_t frame_addr);
+/* returns the number of references on a frame */
+uint32_t frame_refcnt(uint32_t frame_addr);
+/* returns the number of free frames */
+uint32_t frame_nbr_free(void);
+/* returns the end of the highest frame of RAM in the pool (end of the identity mapped region needed) */
+uint32_t frame_pool_end(void);
+
+#endif /* FRAME_H */
@@ -6,6 +6,9 @@
 #include "lib.h"
 #include "x86_desc.h"
 #include "keyboard.h"
+#include "page.h"
+#include "fpu.h"
+#include "scheduler.h"
 
 /*
  * idt_init
@@ -40,14 +43,14 @@ void idt_init(void){
 	SET_IDT_ENTRY(idt[4], OF_expt_handler);
 	SET_IDT_ENTRY(idt[5], BR_expt_handler);
 	SET_IDT_ENTRY(idt[6], UD_expt_handler);
-	SET_IDT_ENTRY(idt[7], NM_expt_handler);
+	SET_IDT_ENTRY(idt[7], nm_handler_link);   //fpu use after a task switch: goes through assembly linkage
 	SET_IDT_ENTRY(idt[8], DF_expt_handler);
 	SET_IDT_ENTRY(idt[9], COP_expt_handler);
 	SET_IDT_ENTRY(idt[10], TS_expt_handler);
 	SET_IDT_ENTRY(idt[11], NP_expt_handler);
 	SET_IDT_ENTRY(idt[12], SS_expt_handler);
 	SET_IDT_ENTRY(idt[13], GP_expt_handler);
-	SET_IDT_ENTRY(idt[14], PF_expt_handler);
+	SET_IDT_ENTRY(idt[14], pf_handler_link);   //page faults can be resolved: goes through assembly linkage
 	SET_IDT_ENTRY(idt[16], MF_expt_handler);  //skipped nbr 15 <== intel defined
 	SET_IDT_ENTRY(idt[17], AC_expt_handler);
 	SET_IDT_ENTRY(idt[18], MC_expt_handler);
@@ -95,6 +98,19 @@ void idt_init(void){
 		idt[RTC_IDT_INDEX].reserved4 = 0;
         SET_IDT_ENTRY(idt[RTC_IDT_INDEX], rtc_handler_link); //set pointer to handler through assembly linkage
 
+    /* ATA DISK INTERRUPT DESCRIPTOR */
+        idt[ATA_IDT_INDEX].dpl = KERNEL_MODE_PREV;  // set user interrupts to have kernel privelege 
+        idt[ATA_IDT_INDEX].present = 1; // validate the descriptor entry
+		idt[ATA_IDT_INDEX].seg_selector = KERNEL_CS; 
+		idt[ATA_IDT_INDEX].size = 1;
+		// fill in reserved bits to match interrupt gate bits
+        idt[ATA_IDT_INDEX].reserved0 = 0;
+		idt[ATA_IDT_INDEX].reserved1 = 1;
+		idt[ATA_IDT_INDEX].reserved2 = 1;
+		idt[ATA_IDT_INDEX].reserved3 = 0;
+		idt[ATA_IDT_INDEX].reserved4 = 0;
+        SET_IDT_ENTRY(idt[ATA_IDT_INDEX], ata_handler_link); //set pointer to handler through assembly linkage
+
 
     //Third: Load system calls (x80)
     
@@ -195,14 +211,14 @@ void UD_expt_handler() {
     while(1){}; //infinite loop
 }/*
  * NM_expt_handler
- *   DESCRIPTION: Dummy to show the appropriate interrupt
+ *   DESCRIPTION: Device not available handler: first fpu instruction of the running task since it got
+ *                the cpu, the task gets the fpu and the instruction is retried (see fpu_trap)
  *   INPUTS: none 
  *   OUTPUTS: none
  *   RETURN VALUE: none
  */
 void NM_expt_handler() {
-	printf("\n-- 7-DEVICE NOT AVAILABLE EXCEPTION OCCURED! -- \n");
-    while(1){}; //infinite loop
+    fpu_trap(sched_current_context());
 }/*
  * DF_expt_handler
  *   DESCRIPTION: Dummy to show the appropriate interrupt
@@ -269,13 +285,18 @@ void GP_expt_handler() {
 }
 /*
  * PF_expt_handler
- *   DESCRIPTION: Dummy to show the appropriate interrupt
- *   INPUTS: none 
+ *   DESCRIPTION: Page fault handler: demand-zero and copy-on-write faults in the user region
+ *                are resolved and the faulting instruction retried, any other fault is fatal
+ *   INPUTS: error_code - error code pushed by the processor
  *   OUTPUTS: none
  *   RETURN VALUE: none
  */
-void PF_expt_handler() {
-	printf("\n-- 14-PAGE FAULT EXCEPTION OCCURED! -- \n");
+void PF_expt_handler(uint32_t error_code) {
+    uint32_t fault_addr;
+    asm volatile ("movl %%cr2, %0" : "=r" (fault_addr));
+    if(page_user_fault(fault_addr, error_code) == 0)
+        return;
+    printf("\n-- 14-PAGE FAULT EXCEPTION OCCURED! addr: %x, error code: %x -- \n", fault_addr, error_code);
     while(1){}; //infinite loop
 }
 /*
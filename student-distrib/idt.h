@@ -5,10 +5,13 @@
 #ifndef IDT_H
 #define IDT_H
 
+#include "types.h"
+
 #define EXCEPT_NUM          32  //number of reserved expections (first 32 entries in IDT)
 #define KEYBOARD_IDT_INDEX  0x21
 #define PIT_IDT_INDEX       0x20
 #define RTC_IDT_INDEX       0x28  
+#define ATA_IDT_INDEX       0x2E
 #define SYSCALL_IDT_INDEX   0x80
 #define USER_MODE_PREV      3
 #define KERNEL_MODE_PREV    0
@@ -25,6 +28,15 @@ void keyboard_handler_link();
 /* interrupt handler for RTC through assembly linkage */
 void rtc_handler_link();
 
+/* interrupt handler for the ATA disk through assembly linkage */
+void ata_handler_link();
+
+/* page fault handler through assembly linkage (passes the error code) */
+void pf_handler_link();
+
+/* device not available handler through assembly linkage (lazy fpu switching) */
+void nm_handler_link();
+
 /* generic system call handler defined through ASM LINKAGE in syscall_linkage.S */ 
 extern void syscall_generic_handler(void);
 
@@ -43,7 +55,7 @@ void TS_expt_handler();
 void NP_expt_handler();
 void SS_expt_handler();
 void GP_expt_handler();
-void PF_expt_handler();
+void PF_expt_handler(uint32_t error_code);
 void MF_expt_handler();
 void AC_expt_handler();
 void MC_expt_handler();
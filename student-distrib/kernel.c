@@ -16,6 +16,9 @@
 #include "filesystem.h"
 #include "syscall_handlers.h"
 #include "pit.h"
+#include "frame.h"
+#include "fpu.h"
+#include "ata.h"
 
 #define RUN_TESTS
 #define KERNAL_START_ADDR 
@@ -155,6 +158,8 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
     idt_init(); //initialize idt
+    sysenter_init(); //fast system call entry
+    ata_init();     //detect the ATA disk
  
     keyboard_init(); //initialize keyboard
     terminal_open();
@@ -162,10 +167,12 @@ void entry(unsigned long magic, unsigned long addr) {
 
     rtc_init();     //initialize RTC
     PIT_init();     //initialize PIT
+    fpu_init();     //initialize FPU (given to tasks lazily)
 
-    filesystem_init(&filesystem_base_addr); //initialize the MP3 filesystem to its base address in memory
-
+    frame_init(mbi); //initialize the physical frame pool from the multiboot memory map
     page_init();    //initialize Paging
+
+    filesystem_init(&filesystem_base_addr); //initialize the MP3 filesystem (on the ATA disk, else at its base address in memory)
     
     clear();
     /* Enable interrupts */
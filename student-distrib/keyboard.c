@@ -97,8 +97,7 @@ void keyboard_inter_handler(){
 
     
     if(active_terminals.current_active_terminal != active_terminals.current_showing_terminal){
-        k_page_vir_phy_map(VIDEO_MEM_ADDR, VIDEO_MEM_ADDR, VIDEO_MEM_SIZE);
-        flush_tlb();
+        k_page_vir_phy_map(VIDEO_MEM_ADDR, VIDEO_MEM_ADDR, VIDEO_MEM_SIZE); // invalidates the remapped page only
         //update_screen_x_y(active_terminals.terminals[active_terminals.current_showing_terminal].screen_x, active_terminals.terminals[active_terminals.current_showing_terminal].screen_y); 
         update_cursor(active_terminals.terminals[active_terminals.current_showing_terminal].screen_x, active_terminals.terminals[active_terminals.current_showing_terminal].screen_y);
         
@@ -166,7 +165,7 @@ void keyboard_inter_handler(){
 
         if(pressed == '\n'){
             if(active_terminals.terminals[active_terminals.current_showing_terminal].input_wait){ // if someone was waitnig for the input, let them know data is ready
-                active_terminals.terminals[active_terminals.current_showing_terminal].input_wait = 0;
+                terminal_input_ready(active_terminals.current_showing_terminal);
             }
             else{
                 clear_KB_buffer(KB_BUF_SIZE); // else throw it away
@@ -203,16 +202,14 @@ void keyboard_inter_handler(){
 
 restore: 
     if(original_terminal != potential_previous_showing){
-        k_page_vir_phy_map(VIDEO_MEM_ADDR, (TERMINAL_1_VIDEO_PAGE_ADDR + original_terminal*PAGE_SIZE), VIDEO_MEM_SIZE);
-        flush_tlb();
+        page_video_update(active_terminals.current_showing_terminal); // undo remap: video memory back to screen or backing page
         if(potential_previous_showing == active_terminals.current_showing_terminal){
             //update_screen_x_y(active_terminals.terminals[original_terminal].screen_x, active_terminals.terminals[original_terminal].screen_y); 
         }
     active_terminals.current_active_terminal = original_terminal;
     }
     else if(potential_previous_showing != active_terminals.current_showing_terminal){
-    k_page_vir_phy_map(VIDEO_MEM_ADDR, (TERMINAL_1_VIDEO_PAGE_ADDR + potential_previous_showing*PAGE_SIZE), VIDEO_MEM_SIZE);
-    flush_tlb();
+    page_video_update(active_terminals.current_showing_terminal);
     }
 
 	// send EOI to PIC
@@ -3,6 +3,33 @@
 
 #include "page.h"
 #include "lib.h"
+#include "syscall_handlers.h"
+#include "frame.h"
+#include "prog_cache.h"
+#include "terminal.h"
+
+// per-process page directories and 4kB page tables of the 4MB user program region (virtual 128MB), each in a frame
+// allocated on first exec of the pid and kept for the next process getting the pid
+static page_directory_entry_t* page_dir_proc[MAX_PROCESS_CNT];
+static page_table_entry_t* page_table_proc[MAX_PROCESS_CNT];
+// per-terminal low 4MB and vidmap (virtual 132MB) page tables: the video memory of a terminal maps to the screen while
+// it is showing, to its backing page otherwise. processes use the tables of their terminal, so a switch is a CR3 write
+static page_table_entry_t page_table_term[NBR_TERMINALS][PAGE_TABLE_NUM_ENTRIES] __attribute__((aligned (PAGE_SIZE)));
+static page_table_entry_t page_table_vidmap_term[NBR_TERMINALS][PAGE_TABLE_NUM_ENTRIES] __attribute__((aligned (PAGE_SIZE)));
+// page directory loaded in CR3
+static page_directory_entry_t* current_page_dir = page_directory;
+// pending tlb invalidations of an open batch (more than PAGE_BATCH_MAX pending: the whole tlb is flushed on commit)
+static uint32_t page_batch_depth = 0;
+static uint32_t page_batch_cnt = 0;
+static uint32_t page_batch_addrs[PAGE_BATCH_MAX];
+// cost of the CR3 writes done by page_user_switch
+static page_switch_stats_t page_switch_stats = {0, 0, 0xFFFFFFFF, 0};
+// pid whose page table is currently mapped at 128MB (page faults in the user region are resolved in it)
+static uint32_t current_user_pid = MAX_PROCESS_CNT;
+// page faults resolved per process since its exec: all of them, and those that filled a page of the executable image
+static uint32_t page_fault_cnt[MAX_PROCESS_CNT];
+static uint32_t page_image_fault_cnt[MAX_PROCESS_CNT];
+
 /* 
  * page_init
  *   DESCRIPTION: initializes all 1024 pages to not pressent, write enable
@@ -24,15 +51,17 @@ void page_init(void){
         page_table[i].val     = PE_CLEAR_SET_RW;
         // set up base indexes just in case
         page_table[i].base_31_12 = i;
-
-        page_table_user[i].val = PE_CLEAR_SET_RW_USER;
-        page_table_user[i].base_31_12 = i; 
     }
 
     page_directory[0].val = ((uint32_t)page_table & BASE_MASK) | PDE_CONTROL_FLAGS_4KB;
 
     page_directory[1].val = (1<<SHIFT_BY_22) | PDE_CONTROL_FLAGS_4MB; // set page size, rw, and present page, base addr = 1
     page_directory[1].global_bit = 1;
+    //frame pool: identity mapped, kernel only (frames are reached through their physical address)
+    for(i = FRAME_POOL_START>>SHIFT_BY_22; (uint32_t)i < (frame_pool_end() + SIZE_4MB_PAGE - 1)>>SHIFT_BY_22; i++){
+        page_directory[i].val = (i<<SHIFT_BY_22) | PDE_CONTROL_FLAGS_4MB;
+        page_directory[i].global_bit = 1;
+    }
     //setup video memory page
     setup_pages_user(&page_table[find_page_index(VIDEO_MEM_ADDR)], (uint32_t)VIDEO_MEM_ADDR, (int)PAGE_SIZE);
     //setup terminal specific video pages ==> SAME MAPPPING ie. virtual = physical addresses
@@ -41,8 +70,19 @@ void page_init(void){
     clear_terminal_video_page((char*)TERMINAL_2_VIDEO_PAGE_ADDR, TERM_2_COLOR); // set the terminal color  
     setup_pages_user(&page_table[find_page_index(TERMINAL_3_VIDEO_PAGE_ADDR)], (uint32_t)TERMINAL_3_VIDEO_PAGE_ADDR, (int)PAGE_SIZE);
     clear_terminal_video_page((char*)TERMINAL_3_VIDEO_PAGE_ADDR, TERM_3_COLOR); // set the terminal color
+    //terminal video pages never move: global (kept in the tlb across CR3 writes)
+    page_table[find_page_index(TERMINAL_1_VIDEO_PAGE_ADDR)].granularity = 1;
+    page_table[find_page_index(TERMINAL_2_VIDEO_PAGE_ADDR)].granularity = 1;
+    page_table[find_page_index(TERMINAL_3_VIDEO_PAGE_ADDR)].granularity = 1;
+
+    //per-terminal copies of the low 4MB page table, and vidmap page tables (only the first page is used)
+    for(i = 0; i < NBR_TERMINALS; i++){
+        memcpy(page_table_term[i], page_table, sizeof(page_table));
+        memset(page_table_vidmap_term[i], 0, sizeof(page_table_vidmap_term[i]));
+    }
  
     enable_paging((int) page_directory);
+    page_video_update(active_terminals.current_showing_terminal);
     // clear_terminal_video_page((int32_t*)TERMINAL_2_VIDEO_PAGE_ADDR); //make it green 
     // clear_terminal_video_page((int32_t*)TERMINAL_3_VIDEO_PAGE_ADDR); //make it green 
 
@@ -132,96 +172,353 @@ void setup_pages_user(page_table_entry_t *page_entry, uint32_t start_addr, int s
 
 
 /* 
- * page_vir_phy_map
- *   DESCRIPTION: Maps a virtual addr to a physical addr in a 4MB page or 4kB page in user space page table
- *   INPUTS: V_ADDR - virtual address to be mapped 
+ * k_page_vir_phy_map
+ *   DESCRIPTION: Maps a virtual addr to a physical addr in 4kB pages of the low 4MB page table in use
+ *                (the kernel's, or the one of the terminal of the running process): temporary video memory remaps,
+ *                undone by page_video_update. only the tlb entries of pages whose mapping changed are invalidated
+ *   INPUTS: V_ADDR - virtual address to be mapped (in the low 4MB)
  *           P_ADDR - the physical address to be mapped to
- *           size   - page size bit-> for whether it is 4MB or 4KB page
+ *           size   - nbr of bytes to map
  *   OUTPUTS: None
- *   RETURN VALUE: -1 = page already present, 0 = success
- *   SIDE EFFECTS: Page entries modified
+ *   RETURN VALUE: -1 = address outside the low 4MB, 0 = success
+ *   SIDE EFFECTS: Page entries modified, tlb entries invalidated
  */
-int page_vir_phy_map(int V_ADDR, int P_ADDR, int size){
-    int dir_index = V_ADDR>>22;    // extract the upper 10 bits (this is the dir index                
+int k_page_vir_phy_map(int V_ADDR, int P_ADDR, int size){
+    page_table_entry_t* low_page_table = (page_table_entry_t*)(current_page_dir[0].val & BASE_MASK);
+    page_table_entry_t* page_entry;
+    uint32_t old_val;
 
-    if(size == 1){ //4MB page option
-        page_directory[dir_index].base_31_12 = P_ADDR>>SHIFT_BY_12; // must right shift 12 as base_31_12 starts at bit 12
-        page_directory[dir_index].page_size  = 1;
+    if(V_ADDR>>SHIFT_BY_22)
+        return -1;
+    page_entry = &low_page_table[find_page_index(V_ADDR)];
+    page_batch_begin();
+    for(; size > 0; V_ADDR += PAGE_SIZE, P_ADDR += PAGE_SIZE, size -= PAGE_SIZE, page_entry++){
+        old_val = page_entry->val;
+        setup_pages_user(page_entry, (uint32_t)P_ADDR, PAGE_SIZE);
+        if(page_entry->val != old_val)
+            page_invalidate(V_ADDR);
     }
-    else{
-        // page_directory[dir_index].base_31_12 = P_ADDR>>22; // shift 22 as only uper 10 bits are used 
-        // page_directory[dir_index].base_31_12 = ;
-        page_directory[dir_index].val = ((uint32_t)page_table_user & BASE_MASK);
+    page_batch_commit();
+    return 0;
+}
+
+/* 
+ * page_video_update
+ *   DESCRIPTION: maps the video memory (and vidmap page) of each terminal: to the screen for the showing terminal,
+ *                to its backing page for the others
+ *   INPUTS: showing_terminal - terminal on screen
+ *   OUTPUTS: None
+ *   RETURN VALUE: -1 = invalid terminal, 0 = success
+ *   SIDE EFFECTS: Page entries of terminal page tables modified, tlb entries of changed pages invalidated
+ */
+int page_video_update(uint32_t showing_terminal){
+    uint32_t i, video_addr, flags;
+    if(showing_terminal >= NBR_TERMINALS)
+        return -1;
+    cli_and_save(flags);
+    page_batch_begin();
+    for(i = 0; i < NBR_TERMINALS; i++){
+        video_addr = (i == showing_terminal) ? VIDEO_MEM_ADDR : (TERMINAL_1_VIDEO_PAGE_ADDR + i*PAGE_SIZE);
+        if(page_table_term[i][find_page_index(VIDEO_MEM_ADDR)].val != (video_addr | PTE_CONTROL_FLAGS_USER)){
+            page_table_term[i][find_page_index(VIDEO_MEM_ADDR)].val = video_addr | PTE_CONTROL_FLAGS_USER;
+            page_invalidate(VIDEO_MEM_ADDR);
+        }
+        if(page_table_vidmap_term[i][find_page_index(USER_VIDMAP_ADDR)].val != (video_addr | PTE_CONTROL_FLAGS_USER)){
+            page_table_vidmap_term[i][find_page_index(USER_VIDMAP_ADDR)].val = video_addr | PTE_CONTROL_FLAGS_USER;
+            page_invalidate(USER_VIDMAP_ADDR);
+        }
     }
-    page_directory[dir_index].present    = 1;
-    page_directory[dir_index].user_super = 1;
-    page_directory[dir_index].read_write = 1;
-    
-    if(size != 1){ // may be incomplete
-        setup_pages_user(&page_table_user[find_page_index(V_ADDR)], (uint32_t)P_ADDR, size); // setup pages for the requested space
+    page_batch_commit();
+    restore_flags(flags);
+    return 0;
+}
+
+/* 
+ * page_user_setup
+ *   DESCRIPTION: sets up the page directory of a process: kernel mappings (shared, global), low 4MB of its terminal,
+ *                and its user region (4MB at virtual 128MB) with no page present: untouched pages get a zeroed frame
+ *                on first access (see page_user_fault). vidmap page is not mapped
+ *   INPUTS: pid      - pid of process owning the page directory
+ *           terminal - terminal the process runs in
+ *   OUTPUTS: None
+ *   RETURN VALUE: -1 = invalid pid or terminal, or out of frames, 0 = success
+ *   SIDE EFFECTS: Page entries modified, page directory and table allocated on first use of pid
+ */
+int page_user_setup(uint32_t pid, uint32_t terminal){
+    int i;
+    if(pid >= MAX_PROCESS_CNT || terminal >= NBR_TERMINALS)
+        return -1;
+    if(page_dir_proc[pid] == NULL && (page_dir_proc[pid] = (page_directory_entry_t*)frame_alloc()) == NULL)
+        return -1;
+    if(page_table_proc[pid] == NULL && (page_table_proc[pid] = (page_table_entry_t*)frame_alloc()) == NULL)
+        return -1;
+    memcpy(page_dir_proc[pid], page_directory, sizeof(page_directory));
+    page_dir_proc[pid][0].val = ((uint32_t)page_table_term[terminal] & BASE_MASK) | PDE_CONTROL_FLAGS_4KB;
+    page_dir_proc[pid][USER_PAGES_VIR_ADDR_START>>SHIFT_BY_22].val = ((uint32_t)page_table_proc[pid] & BASE_MASK) | PDE_CONTROL_FLAGS_4KB_USER;
+    page_dir_proc[pid][USER_VIDMAP_ADDR>>SHIFT_BY_22].val = 0;
+    for(i = 0; i < PAGE_TABLE_NUM_ENTRIES; i++)
+        page_table_proc[pid][i].val = 0;
+    page_fault_cnt[pid] = 0;
+    page_image_fault_cnt[pid] = 0;
+    return 0;
+}
+
+/* 
+ * page_user_map_page
+ *   DESCRIPTION: maps one page of the user region of a process to a frame. the mapping holds its own reference
+ *                on the frame, dropped when the page is unmapped or gets copied on write
+ *   INPUTS: pid    - pid of process owning the page table
+ *           V_ADDR - virtual address of page (inside the user region)
+ *           P_ADDR - physical address of frame
+ *           flags  - PTE flags (PTE_CONTROL_FLAGS_USER, PTE_CONTROL_FLAGS_USER_RO, optionally | PTE_COW)
+ *   OUTPUTS: None
+ *   RETURN VALUE: -1 = invalid pid or address, 0 = success
+ *   SIDE EFFECTS: Page entry modified, frame reference count incremented
+ */
+int page_user_map_page(uint32_t pid, uint32_t V_ADDR, uint32_t P_ADDR, uint32_t flags){
+    if(pid >= MAX_PROCESS_CNT || page_table_proc[pid] == NULL || (V_ADDR>>SHIFT_BY_22) != (USER_PAGES_VIR_ADDR_START>>SHIFT_BY_22))
+        return -1;
+    frame_get(P_ADDR);
+    page_table_proc[pid][find_page_index(V_ADDR)].val = (P_ADDR & BASE_MASK) | flags;
+    return 0;
+}
+
+/* 
+ * page_user_map_file
+ *   DESCRIPTION: marks one page of the user region of a process as backed by its executable image:
+ *                the page stays not present and is filled from the program cache on first access (see prog_cache_fault)
+ *   INPUTS: pid    - pid of process owning the page table
+ *           V_ADDR - virtual address of page (inside the user region)
+ *   OUTPUTS: None
+ *   RETURN VALUE: -1 = invalid pid or address, 0 = success
+ *   SIDE EFFECTS: Page entry modified
+ */
+int page_user_map_file(uint32_t pid, uint32_t V_ADDR){
+    if(pid >= MAX_PROCESS_CNT || page_table_proc[pid] == NULL || (V_ADDR>>SHIFT_BY_22) != (USER_PAGES_VIR_ADDR_START>>SHIFT_BY_22))
+        return -1;
+    page_table_proc[pid][find_page_index(V_ADDR)].val = PTE_FILE;
+    return 0;
+}
+
+/* 
+ * page_user_present
+ *   DESCRIPTION: tells if a page of the user region of a process is mapped to a frame
+ *   INPUTS: pid    - pid of process owning the page table
+ *           V_ADDR - virtual address of page (inside the user region)
+ *   OUTPUTS: None
+ *   RETURN VALUE: 1 = present, 0 = not present (demand-zero or image page not touched yet), -1 = invalid pid or address
+ *   SIDE EFFECTS: none
+ */
+int page_user_present(uint32_t pid, uint32_t V_ADDR){
+    if(pid >= MAX_PROCESS_CNT || page_table_proc[pid] == NULL || (V_ADDR>>SHIFT_BY_22) != (USER_PAGES_VIR_ADDR_START>>SHIFT_BY_22))
+        return -1;
+    return page_table_proc[pid][find_page_index(V_ADDR)].present;
+}
+
+/* 
+ * page_user_teardown
+ *   DESCRIPTION: unmaps every page of the user region of a process and drops its references on their frames
+ *                (private frames are freed, shared ones stay with their other users)
+ *   INPUTS: pid - pid of process owning the page table
+ *   OUTPUTS: None
+ *   RETURN VALUE: -1 = invalid pid, 0 = success
+ *   SIDE EFFECTS: Page entries cleared, frames may be freed. caller must flush the tlb if pid is mapped
+ */
+int page_user_teardown(uint32_t pid){
+    int i;
+    if(pid >= MAX_PROCESS_CNT || page_table_proc[pid] == NULL)
+        return -1;
+    for(i = 0; i < PAGE_TABLE_NUM_ENTRIES; i++){
+        if(page_table_proc[pid][i].present)
+            frame_put(page_table_proc[pid][i].val & BASE_MASK);
+        page_table_proc[pid][i].val = 0;
     }
+    return 0;
+}
 
+/* 
+ * page_user_vidmap
+ *   DESCRIPTION: maps the vidmap page (virtual 132MB) of a process to the video memory of its terminal
+ *   INPUTS: pid      - pid of process
+ *           terminal - terminal the process runs in
+ *   OUTPUTS: None
+ *   RETURN VALUE: -1 = invalid pid or terminal, 0 = success
+ *   SIDE EFFECTS: Page dir entry modified
+ */
+int page_user_vidmap(uint32_t pid, uint32_t terminal){
+    if(pid >= MAX_PROCESS_CNT || page_dir_proc[pid] == NULL || terminal >= NBR_TERMINALS)
+        return -1;
+    page_dir_proc[pid][USER_VIDMAP_ADDR>>SHIFT_BY_22].val = ((uint32_t)page_table_vidmap_term[terminal] & BASE_MASK) | PDE_CONTROL_FLAGS_4KB_USER;
     return 0;
 }
 
+/* 
+ * page_user_switch
+ *   DESCRIPTION: loads the page directory of a process in CR3: the only tlb flush of a context switch
+ *                (kernel pages are global and stay in the tlb). the cycles spent in the CR3 write are recorded
+ *   INPUTS: pid - pid of process to be mapped
+ *   OUTPUTS: None
+ *   RETURN VALUE: -1 = invalid pid, 0 = success
+ *   SIDE EFFECTS: CR3 loaded, tlb flushed (non-global entries)
+ */
+int page_user_switch(uint32_t pid){
+    uint32_t start, end;
+    if(pid >= MAX_PROCESS_CNT || page_dir_proc[pid] == NULL)
+        return -1;
+    current_page_dir = page_dir_proc[pid];
+    current_user_pid = pid;
+
+    asm volatile("rdtsc" : "=a" (start) : : "edx");
+    asm volatile("movl %0, %%cr3" : : "r" (current_page_dir) : "memory");
+    asm volatile("rdtsc" : "=a" (end) : : "edx");
 
+    end -= start;
+    page_switch_stats.nbr_switches++;
+    page_switch_stats.cycles_total += end;
+    if(end < page_switch_stats.cycles_min)
+        page_switch_stats.cycles_min = end;
+    if(end > page_switch_stats.cycles_max)
+        page_switch_stats.cycles_max = end;
+    return 0;
+}
 
 /* 
- * k_page_vir_phy_map
- *   DESCRIPTION: Maps a virtual addr to a physical addr in a 4MB page or 4kB page in kernel space page table
- *   INPUTS: V_ADDR - virtual address to be mapped 
- *           P_ADDR - the physical address to be mapped to
- *           size   - page size bit-> for whether it is 4MB or 4KB page
+ * page_switch_get_stats
+ *   DESCRIPTION: gives the cost of the CR3 writes done by page_user_switch
+ *   INPUTS: None
+ *   OUTPUTS: stats - nbr of switches and cycles spent (total, min, max)
+ *   RETURN VALUE: -1 = NULL pointer, 0 = success
+ *   SIDE EFFECTS: None
+ */
+int page_switch_get_stats(page_switch_stats_t* stats){
+    if(stats == NULL)
+        return -1;
+    *stats = page_switch_stats;
+    return 0;
+}
+
+/* 
+ * page_user_fault
+ *   DESCRIPTION: resolves a page fault in the user region of the process currently mapped at 128MB
+ *                - image page not present: maps the page of the executable image (read from the filesystem if not cached)
+ *                - other page not present: maps a zeroed private frame (demand-zero: stack, bss, heap)
+ *                - write to a copy-on-write page: maps a private copy of the frame RW
+ *                  (or just makes it writable if this mapping is the frame's last user)
+ *   INPUTS: V_ADDR     - faulting virtual address (CR2)
+ *           error_code - error code pushed by the processor
  *   OUTPUTS: None
- *   RETURN VALUE: -1 = page already present, 0 = success
- *   SIDE EFFECTS: Page entries modified
+ *   RETURN VALUE: 0 = fault resolved (retry the access), -1 = real fault (protection violation, bad address, out of memory)
+ *   SIDE EFFECTS: Page entry modified, frames may be allocated, tlb entry of page invalidated
  */
-int k_page_vir_phy_map(int V_ADDR, int P_ADDR, int size){
-    int dir_index = V_ADDR>>22;    // extract the upper 10 bits (this is the dir index                
+int page_user_fault(uint32_t V_ADDR, uint32_t error_code){
+    page_table_entry_t* page_entry;
+    uint32_t old_frame, new_frame;
+
+    if(current_user_pid >= MAX_PROCESS_CNT || (V_ADDR>>SHIFT_BY_22) != (USER_PAGES_VIR_ADDR_START>>SHIFT_BY_22))
+        return -1;
+    page_entry = &page_table_proc[current_user_pid][find_page_index(V_ADDR)];
 
-    if(size == 1){ //4MB page option
-        page_directory[dir_index].base_31_12 = P_ADDR>>SHIFT_BY_12; // must right shift 12 as base_31_12 starts at bit 12
-        page_directory[dir_index].page_size  = 1;
+    if(!(error_code & PF_ERR_PRESENT) && (page_entry->val & PTE_FILE)){ // image page
+        if(prog_cache_fault(current_user_pid, V_ADDR))
+            return -1;
+        page_image_fault_cnt[current_user_pid]++;
     }
-    else{
-        // page_directory[dir_index].base_31_12 = P_ADDR>>22; // shift 22 as only uper 10 bits are used 
-        // page_directory[dir_index].base_31_12 = ;
-        page_directory[dir_index].val = ((uint32_t)page_table & BASE_MASK);
+    else if(!(error_code & PF_ERR_PRESENT)){ // demand-zero
+        if((new_frame = frame_alloc()) == 0)
+            return -1;
+        memset((void*)new_frame, 0, PAGE_SIZE);
+        page_entry->val = new_frame | PTE_CONTROL_FLAGS_USER; // allocation reference becomes the mapping's
     }
-    page_directory[dir_index].present    = 1;
-    page_directory[dir_index].user_super = 1;
-    page_directory[dir_index].read_write = 1;
-    
-    if(size != 1){ // may be incomplete
-        setup_pages_user(&page_table[find_page_index(V_ADDR)], (uint32_t)P_ADDR, size); // setup pages for the requested space
+    else if((error_code & PF_ERR_WRITE) && (page_entry->val & PTE_COW)){ // copy-on-write
+        old_frame = page_entry->val & BASE_MASK;
+        if(frame_refcnt(old_frame) == 1){ // nobody else maps or caches it: take it over
+            page_entry->val = old_frame | PTE_CONTROL_FLAGS_USER;
+        }
+        else{
+            if((new_frame = frame_alloc()) == 0)
+                return -1;
+            memcpy((void*)new_frame, (void*)old_frame, PAGE_SIZE);
+            page_entry->val = new_frame | PTE_CONTROL_FLAGS_USER;
+            frame_put(old_frame);
+        }
     }
+    else
+        return -1;
 
+    page_fault_cnt[current_user_pid]++;
+    page_invalidate(V_ADDR & BASE_MASK);
     return 0;
 }
 
 /* 
- * page_vir_phy_unmap
- *   DESCRIPTION: unmaps a page dir (4MB) from the specified virtual mem location
- *   INPUTS: V_ADDR - virtual address to be un-mapped 
+ * page_user_fault_counts
+ *   DESCRIPTION: gives the nbr of page faults resolved for a process since its exec
+ *   INPUTS: pid - pid of process
+ *   OUTPUTS: nbr_faults       - all resolved faults
+ *            nbr_image_faults - faults that filled a page of the executable image
+ *   RETURN VALUE: -1 = invalid pid, 0 = success
+ *   SIDE EFFECTS: None
+ */
+int page_user_fault_counts(uint32_t pid, uint32_t* nbr_faults, uint32_t* nbr_image_faults){
+    if(pid >= MAX_PROCESS_CNT || nbr_faults == NULL || nbr_image_faults == NULL)
+        return -1;
+    *nbr_faults = page_fault_cnt[pid];
+    *nbr_image_faults = page_image_fault_cnt[pid];
+    return 0;
+}
+
+/* 
+ * page_invalidate
+ *   DESCRIPTION: invalidates the tlb entry of one page whose mapping changed (invlpg). inside a batch the
+ *                invalidation is deferred to page_batch_commit
+ *   INPUTS: V_ADDR - virtual address in the page
  *   OUTPUTS: None
- *   RETURN VALUE: 0 = success
- *   SIDE EFFECTS: Page entries modified
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: tlb entry invalidated (now or on commit)
  */
-int page_vir_phy_unmap(int V_ADDR){
-    int i;
-    int dir_index = V_ADDR>>SHIFT_BY_22;    // extract the upper 10 bits (this is the dir index                
-
-    if(page_directory[dir_index].present){ // check if present
-        if(page_directory[dir_index].page_size){ // check if full of 4kb pages
-            for(i = 0; i < PAGE_DIR_NUM_ENTRIES; i++){
-                if(page_table_user[i].present)
-                    page_table_user[i].present = 0; // may not be a good idea to step through and destroy all of these, but hey this can be a later bug
-            }
-        }
-        page_directory[dir_index].present = 0;
+void page_invalidate(uint32_t V_ADDR){
+    if(page_batch_depth == 0){
+        asm volatile("invlpg (%0)" : : "r" (V_ADDR) : "memory");
+        return;
     }
+    if(page_batch_cnt < PAGE_BATCH_MAX)
+        page_batch_addrs[page_batch_cnt] = V_ADDR;
+    page_batch_cnt++;
+}
 
-    return 0;
+/* 
+ * page_batch_begin
+ *   DESCRIPTION: opens a batch of mapping changes: their tlb invalidations are done together by page_batch_commit.
+ *                batches nest (the outermost commit invalidates). caller must keep interrupts off until the commit
+ *   INPUTS: void
+ *   OUTPUTS: None
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: page_invalidate defers invalidations
+ */
+void page_batch_begin(void){
+    page_batch_depth++;
+}
+
+/* 
+ * page_batch_commit
+ *   DESCRIPTION: closes a batch of mapping changes: invalidates each changed page with invlpg,
+ *                or flushes the whole tlb once if there were more than PAGE_BATCH_MAX changes
+ *   INPUTS: void
+ *   OUTPUTS: None
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: tlb entries invalidated
+ */
+void page_batch_commit(void){
+    uint32_t i;
+    if(page_batch_depth == 0 || --page_batch_depth != 0)
+        return;
+    if(page_batch_cnt > PAGE_BATCH_MAX)
+        flush_tlb();    // remapped pages are never global: a CR3 reload drops them
+    else{
+        for(i = 0; i < page_batch_cnt; i++)
+            asm volatile("invlpg (%0)" : : "r" (page_batch_addrs[i]) : "memory");
+    }
+    page_batch_cnt = 0;
 }
 
 /* 
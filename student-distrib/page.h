@@ -24,6 +24,17 @@
 //sets present, RW, and page size flags
 #define PDE_CONTROL_FLAGS_4MB         0x83
 #define PDE_CONTROL_FLAGS_4MB_USER    0x87
+// sets present, user (and RW) flags of a 4kB page
+#define PTE_CONTROL_FLAGS_USER        0x07
+#define PTE_CONTROL_FLAGS_USER_RO     0x05
+// first "available" bit of a PTE: read-only page is copy-on-write (gets a private copy on first write)
+#define PTE_COW                       0x200
+// second "available" bit, only in a not-present PTE: page is backed by the executable image (filled on first access)
+#define PTE_FILE                      0x400
+
+// page fault error code bits
+#define PF_ERR_PRESENT                0x1
+#define PF_ERR_WRITE                  0x2
 
 #define VIDEO_MEM_ADDR                0xB8000
 #define TERMINAL_1_VIDEO_PAGE_ADDR    VIDEO_MEM_ADDR  + 2*PAGE_SIZE 
@@ -36,6 +47,9 @@
 
 // processses sit in pages starting at 128MB
 #define USER_PAGES_VIR_ADDR_START     0x8000000
+#define PAGE_BATCH_MAX                16       // more changes in a batch: one full flush is cheaper than invlpg each
+#define USER_VIDMAP_ADDR              (USER_PAGES_VIR_ADDR_START + SIZE_4MB_PAGE)
+#define USER_RING_ADDR                (USER_PAGES_VIR_ADDR_START + PAGE_SIZE)  // system call ring (below the image)
 
 #define SHIFT_BY_12       12
 #define SHIFT_BY_22       22
@@ -89,23 +103,54 @@ typedef struct page_table_entry {
 } page_table_entry_t;
 
 
+/* cost of the CR3 writes of context switches (rdtsc cycles) */
+typedef struct page_switch_stats {
+    uint32_t nbr_switches;
+    uint32_t cycles_total;
+    uint32_t cycles_min;
+    uint32_t cycles_max;
+} page_switch_stats_t;
+
 /* allocated pages non-user */
 extern void setup_pages(page_table_entry_t *page_entry, uint32_t start_addr, int size);
 /* allocated pages for user */
 extern void setup_pages_user(page_table_entry_t *page_entry, uint32_t start_addr, int size);
-/* Maps a virtual addr to a physical addr in a 4MB page or 4kB page in user space page table*/
-extern int page_vir_phy_map(int V_ADDR, int P_ADDR, int size);
-/* Maps a virtual addr to a physical addr in a 4MB page or 4kB page in kernel space page table*/
+/* Maps a virtual addr to a physical addr in 4kB pages of the low 4MB page table in use */
 extern int k_page_vir_phy_map(int V_ADDR, int P_ADDR, int size);
-/* unmaps a page dir (4MB) from the specified virtual mem location */
-extern int page_vir_phy_unmap(int V_ADDR);
-/* flushes tlb  */
+/* maps the video memory of each terminal to the screen (showing terminal) or to its backing page */
+extern int page_video_update(uint32_t showing_terminal);
+/* sets up the page directory of a process: kernel, its terminal's low 4MB, user region with every page demand-zero */
+extern int page_user_setup(uint32_t pid, uint32_t terminal);
+/* maps the vidmap page of a process to the video memory of its terminal */
+extern int page_user_vidmap(uint32_t pid, uint32_t terminal);
+/* maps one page of the user region of a process to a frame (takes a reference on the frame) */
+extern int page_user_map_page(uint32_t pid, uint32_t V_ADDR, uint32_t P_ADDR, uint32_t flags);
+/* tells if a page of the user region of a process is mapped to a frame */
+extern int page_user_present(uint32_t pid, uint32_t V_ADDR);
+/* unmaps every page of the user region of a process and drops its references on their frames */
+extern int page_user_teardown(uint32_t pid);
+/* loads the page directory of a process (one CR3 write) */
+extern int page_user_switch(uint32_t pid);
+/* gives the cost of the CR3 writes done by page_user_switch */
+extern int page_switch_get_stats(page_switch_stats_t* stats);
+/* marks one page of the user region of a process as backed by its executable image (not present until touched) */
+extern int page_user_map_file(uint32_t pid, uint32_t V_ADDR);
+/* resolves a page fault in the user region of the mapped process (image, demand-zero and copy-on-write) */
+extern int page_user_fault(uint32_t V_ADDR, uint32_t error_code);
+/* gives the nbr of page faults resolved for a process since its exec (total, and those that filled image pages) */
+extern int page_user_fault_counts(uint32_t pid, uint32_t* nbr_faults, uint32_t* nbr_image_faults);
+/* invalidates the tlb entry of one page (deferred inside a batch) */
+extern void page_invalidate(uint32_t V_ADDR);
+/* opens a batch of mapping changes invalidated together */
+extern void page_batch_begin(void);
+/* invalidates the pages changed in a batch (invlpg each, or one flush) */
+extern void page_batch_commit(void);
+/* flushes tlb (non-global entries) */
 extern void flush_tlb(void);
 
 // page tables allocated (as we go)
 page_directory_entry_t page_directory[PAGE_DIR_NUM_ENTRIES] __attribute__((aligned (PAGE_SIZE)));
 page_table_entry_t     page_table[PAGE_TABLE_NUM_ENTRIES]   __attribute__((aligned (PAGE_SIZE)));
-page_table_entry_t     page_table_user[PAGE_TABLE_NUM_ENTRIES]   __attribute__((aligned (PAGE_SIZE)));
 
 #endif /* ASM */
 #endif /* PAGE_H */
@@ -0,0 +1,293 @@
+/* page_cache.c - Defines the page cache of file data: blocks of files kept in frames, keyed by (inode, block),
+ *                with read-ahead of sequential reads. reads copy from the cache, only misses go to the backing
+ *                store (read_block). read-ahead only queues disk reads (prefetch_blocks): pages are filled when read
+ * vim:ts=4 noexpandtab
+ */
+
+#include "page_cache.h"
+#include "lib.h"
+#include "frame.h"
+
+static page_cache_page_t pc_pages[PAGE_CACHE_NBR_PAGES];
+static page_cache_page_t* pc_hash[PAGE_CACHE_HASH_SIZE];   // chains of valid pages by (inode, block)
+static page_cache_page_t* pc_lru_head = NULL;              // pages holding a frame, most recently used first
+static page_cache_page_t* pc_lru_tail = NULL;              // (invalid pages are kept at the tail: reused first)
+static uint32_t pc_nbr_pages = 0;                          // pages given a frame so far
+static page_cache_stats_t pc_stats;
+
+/*
+ * pc_hash_slot
+ *   DESCRIPTION: gives the hash chain of a block of a file
+ *   INPUTS: inode_num: inode of file -- blk_index: index of block in file
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: slot of pc_hash
+ */
+static uint32_t pc_hash_slot(uint32_t inode_num, uint32_t blk_index){
+    return ((inode_num << 4) ^ blk_index) & (PAGE_CACHE_HASH_SIZE - 1);
+}
+
+/*
+ * pc_lru_unlink
+ *   DESCRIPTION: removes a page from the lru list
+ *   INPUTS: page: page in lru list
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: modifies list
+ *   RETURN VALUE: none
+ */
+static void pc_lru_unlink(page_cache_page_t* page){
+    if (page->lru_prev != NULL)
+        page->lru_prev->lru_next = page->lru_next;
+    else
+        pc_lru_head = page->lru_next;
+    if (page->lru_next != NULL)
+        page->lru_next->lru_prev = page->lru_prev;
+    else
+        pc_lru_tail = page->lru_prev;
+    page->lru_prev = page->lru_next = NULL;
+}
+
+/*
+ * pc_lru_push
+ *   DESCRIPTION: links a page at the head (most recently used) or tail (reused first) of the lru list
+ *   INPUTS: page: page not in lru list -- tail: 1 = at tail, 0 = at head
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: modifies list
+ *   RETURN VALUE: none
+ */
+static void pc_lru_push(page_cache_page_t* page, uint32_t tail){
+    if (tail){
+        page->lru_next = NULL;
+        page->lru_prev = pc_lru_tail;
+        if (pc_lru_tail != NULL)
+            pc_lru_tail->lru_next = page;
+        else
+            pc_lru_head = page;
+        pc_lru_tail = page;
+    }
+    else{
+        page->lru_prev = NULL;
+        page->lru_next = pc_lru_head;
+        if (pc_lru_head != NULL)
+            pc_lru_head->lru_prev = page;
+        else
+            pc_lru_tail = page;
+        pc_lru_head = page;
+    }
+}
+
+/*
+ * pc_lookup
+ *   DESCRIPTION: finds the page holding a block of a file
+ *   INPUTS: inode_num: inode of file -- blk_index: index of block in file
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: pointer to page or NULL if the block is not cached
+ */
+static page_cache_page_t* pc_lookup(uint32_t inode_num, uint32_t blk_index){
+    page_cache_page_t* page;
+    for (page = pc_hash[pc_hash_slot(inode_num, blk_index)]; page != NULL; page = page->hash_next)
+        if (page->inode_num == inode_num && page->blk_index == blk_index)
+            return page;
+    return NULL;
+}
+
+/*
+ * pc_evict
+ *   DESCRIPTION: gives a page to hold a new block: a page not used yet (its frame is allocated), else the least
+ *                recently used page no read is copying from, which loses its block
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may allocate a frame, modifies hash chains
+ *   RETURN VALUE: pointer to page (invalid, in no list) or NULL if out of frames with no page to reuse (or every
+ *                 page in use)
+ */
+static page_cache_page_t* pc_evict(void){
+    page_cache_page_t* page;
+    page_cache_page_t** link;
+    uint32_t frame;
+
+    if (pc_nbr_pages < PAGE_CACHE_NBR_PAGES && (frame = frame_alloc()) != 0){
+        page = &pc_pages[pc_nbr_pages++];
+        page->data = (uint8_t*)frame;   // frames are identity mapped for the kernel
+        page->valid = 0;
+        return page;
+    }
+    for (page = pc_lru_tail; page != NULL && page->ref_cnt != 0; page = page->lru_prev);
+    if (page == NULL)
+        return NULL;
+    pc_lru_unlink(page);
+    if (page->valid){
+        for (link = &pc_hash[pc_hash_slot(page->inode_num, page->blk_index)]; *link != page; link = &(*link)->hash_next);
+        *link = page->hash_next;
+        page->valid = 0;
+    }
+    return page;
+}
+
+/*
+ * pc_get
+ *   DESCRIPTION: gives the page holding a block of a file, read from the backing store on a miss. the read may
+ *                sleep on the disk: if another task cached the block meanwhile, its page is used
+ *   INPUTS: inode_num: inode of file -- blk_index: index of block in file
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: page becomes the most recently used, may evict another block, may switch tasks
+ *   RETURN VALUE: pointer to page or NULL (bad block, or no page available)
+ */
+static page_cache_page_t* pc_get(uint32_t inode_num, uint32_t blk_index){
+    page_cache_page_t* page;
+    page_cache_page_t* cached;
+    int32_t len;
+    uint32_t slot;
+
+    if ((page = pc_lookup(inode_num, blk_index)) != NULL){
+        pc_stats.nbr_hits++;
+        pc_lru_unlink(page);
+        pc_lru_push(page, 0);
+        return page;
+    }
+    if ((page = pc_evict()) == NULL)
+        return NULL;
+    len = read_block(inode_num, blk_index, page->data);   // (page in no list: no other task takes it)
+    if (len <= 0 || (cached = pc_lookup(inode_num, blk_index)) != NULL){
+        pc_lru_push(page, 1);   // stays invalid, reused first
+        if (len <= 0)
+            return NULL;
+        pc_stats.nbr_hits++;    // read by another task while this one slept
+        pc_lru_unlink(cached);
+        pc_lru_push(cached, 0);
+        return cached;
+    }
+    pc_stats.nbr_misses++;
+    page->valid = 1;
+    page->inode_num = inode_num;
+    page->blk_index = blk_index;
+    page->len = (uint32_t)len;
+    slot = pc_hash_slot(inode_num, blk_index);
+    page->hash_next = pc_hash[slot];
+    pc_hash[slot] = page;
+    pc_lru_push(page, 0);
+    return page;
+}
+
+/*
+ * page_cache_open
+ *   DESCRIPTION: forgets the remembered page and read-ahead state of an fd, for a file being opened on it
+ *   INPUTS: file: fd entry
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: none
+ */
+void page_cache_open(fd_arr_entry_t* file){
+    file->pc_page = NULL;
+    file->ra_next = 0;
+    file->ra_window = 0;
+    file->ra_end = 0;
+}
+
+/*
+ * page_cache_read
+ *   DESCRIPTION: reads from a regular file at the position of its fd through the page cache. the page of the last
+ *                block read is remembered in the fd, so small reads in one block skip the lookup. a read that starts
+ *                in the block the previous one ended in (or the next one) is sequential: the reads of the blocks
+ *                past it that are not cached are queued (not waited for, nothing is copied for them), the window
+ *                doubling up to PAGE_CACHE_RA_MAX while reads stay sequential
+ *   INPUTS: file: fd entry of the file (inode, position, page cache state)
+ *           buf: buffer to fill -- length: max nbr of bytes to read
+ *   OUTPUTS: buf: filled
+ *   SIDE EFFECTS: fills the cache with the blocks read, queues disk reads ahead, updates the page cache state of
+ *                 the fd (not its position)
+ *   RETURN VALUE: number of bytes read (0 at end of file) or -1 (bad inode or block)
+ */
+int32_t page_cache_read(fd_arr_entry_t* file, uint8_t* buf, uint32_t length){
+    page_cache_page_t* page;
+    uint32_t inode_num = file->inode_num;
+    uint32_t pos = file->file_position;
+    uint32_t flags, done, blk, off, span, first_blk, last_blk, b, run_end, end, file_blks;
+    int32_t file_len = get_file_size_byinode_num(inode_num);
+    int32_t n;
+
+    if (file_len < 0 || buf == NULL)
+        return -1;
+    if (pos >= (uint32_t)file_len || length == 0)
+        return 0;
+    if (length > (uint32_t)file_len - pos)
+        length = (uint32_t)file_len - pos;
+
+    cli_and_save(flags);
+    for (done = 0; done < length; done += span){
+        blk = (pos + done) / FILESYSTEM_BLOCK_SIZE;
+        off = (pos + done) % FILESYSTEM_BLOCK_SIZE;
+        page = file->pc_page;
+        if (page != NULL && page->valid && page->inode_num == inode_num && page->blk_index == blk){
+            pc_stats.nbr_hits++;
+            pc_stats.nbr_fd_hits++;
+        }
+        else if ((page = pc_get(inode_num, blk)) == NULL){   // no page: read the rest straight from the file
+            n = read_data(inode_num, pos + done, buf + done, length - done);
+            restore_flags(flags);
+            if (n < 0)
+                return (done > 0) ? (int32_t)done : -1;
+            return done + n;
+        }
+        span = FILESYSTEM_BLOCK_SIZE - off;
+        if (span > length - done)
+            span = length - done;
+        if (off + span > page->len)     // (file shorter than when the block was cached)
+            span = (off < page->len) ? page->len - off : 0;
+        if (span == 0)
+            break;
+        page->ref_cnt++;    // (buf may be an image page not loaded yet: its fault sleeps on the disk)
+        memcpy(buf + done, page->data + off, span);
+        page->ref_cnt--;
+        file->pc_page = page;
+    }
+
+    // read-ahead of sequential reads
+    first_blk = pos / FILESYSTEM_BLOCK_SIZE;
+    last_blk = (done > 0) ? (pos + done - 1) / FILESYSTEM_BLOCK_SIZE : first_blk;
+    if (first_blk == file->ra_next || first_blk == file->ra_next + 1){
+        if (file->ra_window == 0)
+            file->ra_window = PAGE_CACHE_RA_MIN;
+        else if (last_blk != file->ra_next && file->ra_window < PAGE_CACHE_RA_MAX)
+            file->ra_window *= 2;
+        end = last_blk + 1 + file->ra_window;
+        b = (file->ra_end > last_blk + 1) ? file->ra_end : last_blk + 1;   // blocks before ra_end were asked for already
+        if (end > file->ra_end)
+            file->ra_end = end;
+        file_blks = ((uint32_t)file_len + FILESYSTEM_BLOCK_SIZE - 1) / FILESYSTEM_BLOCK_SIZE;
+        if (end > file_blks)
+            end = file_blks;
+        for (; b < end; b = run_end){
+            while (b < end && pc_lookup(inode_num, b) != NULL)  // cached: nothing to read
+                b++;
+            for (run_end = b; run_end < end && pc_lookup(inode_num, run_end) == NULL; run_end++);
+            if (run_end > b){   // queued together, merged by the drive (nothing to do for the boot module)
+                prefetch_blocks(inode_num, b, run_end - b);
+                pc_stats.nbr_read_ahead += run_end - b;
+            }
+        }
+    }
+    else{   // random access: no read-ahead until reads are sequential again
+        file->ra_window = 0;
+        file->ra_end = last_blk + 1;
+    }
+    file->ra_next = last_blk;
+    restore_flags(flags);
+    return done;
+}
+
+/*
+ * page_cache_get_stats
+ *   DESCRIPTION: gives the statistics of the page cache
+ *   INPUTS: stats: struct to fill
+ *   OUTPUTS: stats: filled
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: none
+ */
+void page_cache_get_stats(page_cache_stats_t* stats){
+    uint32_t flags;
+    cli_and_save(flags);
+    *stats = pc_stats;
+    restore_flags(flags);
+}
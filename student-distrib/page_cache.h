@@ -0,0 +1,45 @@
+/* page_cache.h - Defines the page cache of file data: blocks of files kept in frames, keyed by (inode, block),
+ *                with read-ahead of sequential reads
+ * vim:ts=4 noexpandtab
+ */
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include "types.h"
+#include "filesystem.h"
+#include "syscall_handlers.h"
+
+#define PAGE_CACHE_NBR_PAGES      64       // frames of file data (allocated on first use)
+#define PAGE_CACHE_HASH_SIZE      128      // power of 2
+#define PAGE_CACHE_RA_MIN         2        // read-ahead window of a read found sequential (blocks)
+#define PAGE_CACHE_RA_MAX         16       // window doubles while reads stay sequential, up to this
+
+/* PAGE CACHE PAGE: one block of a file */
+typedef struct page_cache_page {
+    struct page_cache_page* hash_next;    // in hash chain of (inode, block)
+    struct page_cache_page* lru_prev;     // in lru list (head: most recently used)
+    struct page_cache_page* lru_next;
+    uint32_t valid;             // holds a block
+    uint32_t inode_num;
+    uint32_t blk_index;         // index of the block in the file
+    uint32_t len;               // nbr of bytes of the file in the block
+    uint32_t ref_cnt;           // reads copying from the page (a page in use is not evicted)
+    uint8_t* data;              // frame holding the block
+} page_cache_page_t;
+
+/* PAGE CACHE STATISTICS */
+typedef struct page_cache_stats {
+    uint32_t nbr_hits;          // blocks found in the cache
+    uint32_t nbr_fd_hits;       // of which found through the page remembered by the fd (no lookup)
+    uint32_t nbr_misses;        // blocks read from the backing store by a read
+    uint32_t nbr_read_ahead;    // blocks asked ahead of reads (disk reads queued, not waited for)
+} page_cache_stats_t;
+
+/* reads from a regular file at the position of its fd through the page cache, returns the nbr of bytes read */
+int32_t page_cache_read(fd_arr_entry_t* file, uint8_t* buf, uint32_t length);
+/* forgets the page and read-ahead state of an fd (file opened) */
+void page_cache_open(fd_arr_entry_t* file);
+/* gives the statistics of the page cache */
+void page_cache_get_stats(page_cache_stats_t* stats);
+
+#endif /* PAGE_CACHE_H */
@@ -1,10 +1,17 @@
 #include "pit.h"
 #include "i8259.h"
 #include "scheduler.h"
+#include "timer.h"
 #include "lib.h"
 
 /* Information about ports seen from OSDEV- https://wiki.osdev.org/PIT */
 
+#define PIT_CALIBRATE_MAX_POLLS  0x1000000 // gives up calibration if the output never goes high
+
+uint32_t PIT_tsc_per_tick = 0;
+static uint32_t pit_armed_count = 0;   // PIT clocks programmed for the next interrupt, 0 = stopped
+static uint32_t pit_clock = 0;         // PIT clocks counted by the periods ended (wraps: use differences)
+
 /*
  * PIT_set_div
  *   DESCRIPTION: sends the bits to channel 0 according to the timer
@@ -14,25 +21,160 @@
  */
 void PIT_set_div(uint16_t divisor){
     outb(divisor & 0xFF, PIT_CHANNEL_0_PORT);         // send lower byte
-    outb((divisor & 0xFF00 )<< 8, PIT_CHANNEL_0_PORT); // send upper byteest
+    outb((divisor & 0xFF00) >> 8, PIT_CHANNEL_0_PORT); // send upper byte
     return;
 }
 
+/*
+ * PIT_calibrate_tsc
+ *   DESCRIPTION: measures the rdtsc cycles of a tick: counts one tick in one-shot mode (interrupt masked)
+ *                and polls the output pin until it is done
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sets PIT_tsc_per_tick (stays 0 if the PIT did not answer)
+ */
+static void PIT_calibrate_tsc(void){
+    uint64_t start, end;
+    uint32_t i;
+
+    outb(PIT_CMD_ONESHOT, PIT_COMMAND_REG_PORT);
+    PIT_set_div(PIT_TICK_DIV);
+    asm volatile("rdtsc" : "=A" (start));
+    for(i = 0; i < PIT_CALIBRATE_MAX_POLLS; i++){
+        outb(PIT_CMD_READBACK, PIT_COMMAND_REG_PORT);
+        if(inb(PIT_CHANNEL_0_PORT) & PIT_STATUS_OUT)
+            break;
+    }
+    asm volatile("rdtsc" : "=A" (end));
+    if(i < PIT_CALIBRATE_MAX_POLLS)
+        PIT_tsc_per_tick = (uint32_t)(end - start);
+}
+
 /*
  * PIT_init
- *   DESCRIPTION: initialise the PIT
+ *   DESCRIPTION: initialise the PIT: one-shot mode (the scheduler programs each interrupt), first tick armed
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
  */
 void PIT_init(void){
-    outb(PIT_CMD_INIT, PIT_COMMAND_REG_PORT);         // send lower byte
-    PIT_set_div(PIT_20MS_DIV); // set to 20ms quanta
+    PIT_calibrate_tsc();
+    PIT_arm(PIT_TICK_DIV); // first tick starts the shells
     enable_irq(PIT_IRQ_NUM);
     return;
 }
 
+/*
+ * PIT_arm
+ *   DESCRIPTION: programs the next timer interrupt (one-shot), replacing the one programmed (its time so far is counted)
+ *   INPUTS: count - PIT clocks from now (capped to PIT_ONESHOT_MAX, at least 1)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void PIT_arm(uint32_t count){
+    uint32_t flags;
+    if(count > PIT_ONESHOT_MAX)
+        count = PIT_ONESHOT_MAX;
+    if(count == 0)
+        count = 1;
+    cli_and_save(flags);
+    pit_clock += PIT_elapsed();
+    outb(PIT_CMD_ONESHOT, PIT_COMMAND_REG_PORT);
+    PIT_set_div((uint16_t)count);
+    pit_armed_count = count;
+    restore_flags(flags);
+}
+
+/*
+ * PIT_stop
+ *   DESCRIPTION: cancels the next timer interrupt (writing the mode stops the count until a new one is written),
+ *                the time of the period so far is counted
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void PIT_stop(void){
+    uint32_t flags;
+    cli_and_save(flags);
+    if(pit_armed_count != 0){
+        pit_clock += PIT_elapsed();
+        outb(PIT_CMD_ONESHOT, PIT_COMMAND_REG_PORT);
+        pit_armed_count = 0;
+    }
+    restore_flags(flags);
+}
+
+/*
+ * PIT_armed
+ *   DESCRIPTION: tells if a timer interrupt is programmed
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: PIT clocks of the period programmed, 0 if stopped
+ */
+uint32_t PIT_armed(void){
+    return pit_armed_count;
+}
+
+/*
+ * PIT_elapsed
+ *   DESCRIPTION: gives the time since the timer was armed, from the latched count
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: PIT clocks (the whole period once it is done), 0 if stopped
+ */
+uint32_t PIT_elapsed(void){
+    uint32_t flags, count;
+    cli_and_save(flags);
+    if(pit_armed_count == 0){
+        restore_flags(flags);
+        return 0;
+    }
+    outb(PIT_CMD_LATCH, PIT_COMMAND_REG_PORT);
+    count = inb(PIT_CHANNEL_0_PORT);
+    count |= inb(PIT_CHANNEL_0_PORT) << 8;
+    restore_flags(flags);
+    if(count == 0 || count > pit_armed_count)  // done: the counter wrapped around
+        return pit_armed_count;
+    return pit_armed_count - count;
+}
+
+/*
+ * PIT_expired
+ *   DESCRIPTION: called on a timer interrupt: counts the period that just ended, the timer is stopped until armed again
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: PIT clocks of period (0 if the timer was stopped meanwhile)
+ */
+uint32_t PIT_expired(void){
+    uint32_t count = pit_armed_count;
+    pit_clock += count;
+    pit_armed_count = 0;
+    return count;
+}
+
+/*
+ * PIT_now
+ *   DESCRIPTION: gives the time counted by the timer: runs while the timer is armed, which it always is while
+ *                a kernel timer is pending or tasks compete for the cpu (stands still otherwise)
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: PIT clocks (wraps around after an hour: use differences)
+ */
+uint32_t PIT_now(void){
+    return pit_clock + PIT_elapsed();
+}
+
+/*
+ * PIT_handler
+ *   DESCRIPTION: timer interrupt: ends the period, runs the kernel timers expired, then the scheduler
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
 void PIT_handler(void){
+    PIT_expired();
+    timer_run();
     scheduler();
     // will schedualling really return? I don't think so
     // // !!call EOI in scheduling!!
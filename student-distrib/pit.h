@@ -14,16 +14,40 @@
 // { 2'b channel , 2'b Access Mode , 3'b Operating Mode , 1'b BDC mode}
 
 #define PIT_CMD_INIT  0x34 // {00, 11, 010, 0} = channel 0, low then high byte access, rate gen mode, 16-bit mode
+#define PIT_CMD_ONESHOT   0x30 // {00, 11, 000, 0} = channel 0, low then high byte access, interrupt on terminal count
+#define PIT_CMD_LATCH     0x00 // {00, 00, ...} = latch count of channel 0
+#define PIT_CMD_READBACK  0xE2 // {11, 1, 0, 001, 0} = read back status (not count) of channel 0
+#define PIT_STATUS_OUT    0x80 // output pin in read back status (high once the one-shot count is done)
 #define PIT_IRQ_NUM   0
 
 #define MAX_F_DIV            65535
 
 #define PIT_OSC_FREQ         1193182 //=Hz
 
+// one-shot timer: counts in PIT clocks, a scheduler tick is 20 ms
+#define PIT_TICK_DIV         PIT_20MS_DIV
+#define PIT_ONESHOT_MAX      (2 * PIT_TICK_DIV) // longest one-shot (16-bit counter): 2 ticks
+
+// rdtsc cycles in a tick (calibrated against the PIT), 0 if unknown
+extern uint32_t PIT_tsc_per_tick;
+
 void PIT_set_div(uint16_t divisor);
 
 void PIT_init(void);
 
+/* programs one interrupt count PIT clocks from now (capped to PIT_ONESHOT_MAX) */
+void PIT_arm(uint32_t count);
+/* cancels the next interrupt: no tick until PIT_arm */
+void PIT_stop(void);
+/* PIT clocks programmed for the next interrupt (0 if stopped) */
+uint32_t PIT_armed(void);
+/* PIT clocks since the timer was armed (0 if stopped) */
+uint32_t PIT_elapsed(void);
+/* PIT clocks of the period that just ended (timer interrupt), timer stopped */
+uint32_t PIT_expired(void);
+/* PIT clocks counted by the timer (runs while armed, use differences) */
+uint32_t PIT_now(void);
+
 extern void PIT_handler(void);
 
 #endif /* PIT_H */
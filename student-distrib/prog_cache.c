@@ -0,0 +1,206 @@
+/* prog_cache.c - Defines the program image cache shared by processes running the same executable
+ * vim:ts=4 noexpandtab
+ */
+
+#include "prog_cache.h"
+#include "lib.h"
+#include "frame.h"
+
+static prog_cache_slot_t prog_cache_slots[PROG_CACHE_NBR_SLOTS];
+static uint32_t prog_cache_clock = 0;   // incremented on every lookup, stamps last_use
+static prog_cache_mapping_t prog_cache_mappings[MAX_PROCESS_CNT];   // image mapped by each process
+
+/*
+ * count_text_pages
+ *   DESCRIPTION: finds how many leading pages of an image loaded at USER_IMG_ADDR are never written by the program,
+ *                ie. pages holding file bytes that come before the first page of any writable PT_LOAD segment
+ *   INPUTS: image: pointer to first page of loaded image -- image_len: nbr of bytes of image
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: nbr of pages that can be shared read-only (0 if program headers can't be read)
+ */
+static uint32_t count_text_pages(uint8_t* image, uint32_t image_len){
+    uint32_t header_len = (image_len < PAGE_SIZE) ? image_len : PAGE_SIZE;  // program headers must sit in the first page
+    uint32_t phoff = *(uint32_t*)(image + ELF_PHOFF_LOC);
+    uint32_t phentsize = *(uint16_t*)(image + ELF_PHENTSIZE_LOC);
+    uint32_t phnum = *(uint16_t*)(image + ELF_PHNUM_LOC);
+    uint32_t nbr_pages = (image_len + PAGE_SIZE - 1) / PAGE_SIZE; // pages holding file bytes
+    uint32_t i, vaddr, first_written_page;
+    uint8_t* phdr;
+
+    if (header_len < ELF_PHNUM_LOC + 2 || phentsize < ELF_PHDR_MIN_SIZE || phnum == 0 || phoff + phnum * phentsize > header_len)
+        return 0;  // can't tell what is written: whole image is copy-on-write
+
+    for (i = 0; i < phnum; i++){
+        phdr = image + phoff + i * phentsize;
+        if (*(uint32_t*)(phdr + ELF_PHDR_TYPE_LOC) != ELF_PT_LOAD || !(*(uint32_t*)(phdr + ELF_PHDR_FLAGS_LOC) & ELF_PF_W)
+            || *(uint32_t*)(phdr + ELF_PHDR_MEMSZ_LOC) == 0)
+            continue;
+        vaddr = *(uint32_t*)(phdr + ELF_PHDR_VADDR_LOC);
+        first_written_page = (vaddr < USER_IMG_ADDR) ? 0 : (vaddr - USER_IMG_ADDR) / PAGE_SIZE;
+        if (first_written_page < nbr_pages)
+            nbr_pages = first_written_page;
+    }
+    return nbr_pages;
+}
+
+/*
+ * prog_cache_release
+ *   DESCRIPTION: empties a slot, dropping its references on the frames of the image
+ *                (frames still mapped by processes stay with them)
+ *   INPUTS: slot: pointer to slot
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: frames may be freed
+ *   RETURN VALUE: none
+ */
+static void prog_cache_release(prog_cache_slot_t* slot){
+    uint32_t i;
+    for (i = 0; i < PROG_CACHE_SLOT_PAGES; i++){
+        if (slot->frames[i] != 0)
+            frame_put(slot->frames[i]);
+        slot->frames[i] = 0;
+    }
+    slot->valid = 0;
+}
+
+/*
+ * prog_cache_load_page
+ *   DESCRIPTION: reads one page of the image of a slot from the filesystem into a new frame, zeroes the rest of the page.
+ *                the slot is busy while the task may sleep on the disk, so it is not given to another image: if another
+ *                task loaded the same page meanwhile, its frame is kept and the new one dropped
+ *   INPUTS: slot: pointer to slot (inode_num and image_len set) -- page: page index in the image
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: allocates a frame, referenced by the slot, may switch tasks
+ *   RETURN VALUE: 0 = success (slot->frames[page] set), -1 = out of frames or read failed
+ */
+static int32_t prog_cache_load_page(prog_cache_slot_t* slot, uint32_t page){
+    uint32_t frame, page_len, inode_num = slot->inode_num;
+    int32_t len;
+
+    if ((frame = frame_alloc()) == 0)
+        return -1;
+    page_len = (slot->image_len - page * PAGE_SIZE < PAGE_SIZE) ? slot->image_len - page * PAGE_SIZE : PAGE_SIZE;
+    slot->busy++;
+    len = read_data(inode_num, page * PAGE_SIZE, (uint8_t*)frame, page_len);
+    slot->busy--;
+    if (len != (int32_t)page_len || slot->inode_num != inode_num || slot->frames[page] != 0){
+        frame_put(frame);
+        return (len == (int32_t)page_len && slot->inode_num == inode_num) ? 0 : -1;
+    }
+    if (page_len < PAGE_SIZE)
+        memset((uint8_t*)frame + page_len, 0, PAGE_SIZE - page_len);
+    slot->frames[page] = frame;
+    return 0;
+}
+
+/*
+ * prog_cache_get
+ *   DESCRIPTION: returns the cache slot holding the image of an executable.
+ *                on a miss a free slot (or the least recently used image) is given to the executable, only its
+ *                first page is read (program headers: read-only leading pages are found), the others are read on first access.
+ *                slots busy loading a page are never given to another executable
+ *   INPUTS: inode_num: inode of executable -- exe_info: validated exec metadata of the executable (see get_exe_info)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may allocate a frame and evict an image, may switch tasks (read of the first page)
+ *   RETURN VALUE: pointer to slot (valid until the next call that may replace it: prog_cache_get or a task switch,
+ *                 unless the slot is busy) or NULL (out of frames, read failed or every slot busy)
+ */
+prog_cache_slot_t* prog_cache_get(uint32_t inode_num, const exe_meta_t* exe_info){
+    uint32_t i, image_len;
+    prog_cache_slot_t* victim = NULL;
+    prog_cache_slot_t* slot;
+
+    if (exe_info == NULL)
+        return NULL;
+    image_len = (exe_info->image_len > MAX_FILELENGTH) ? MAX_FILELENGTH : exe_info->image_len;
+    prog_cache_clock++;
+
+    for (i = 0; i < PROG_CACHE_NBR_SLOTS; i++){
+        slot = &prog_cache_slots[i];
+        if (slot->valid && slot->inode_num == inode_num && slot->image_len == image_len &&
+            slot->fs_generation == exe_info->fs_generation){   // hit: same file, unchanged
+            slot->last_use = prog_cache_clock;
+            return slot;
+        }
+        // remember a free slot, or else the least recently used one (not one being loaded)
+        if (slot->busy)
+            continue;
+        if (!slot->valid){
+            if (victim == NULL || victim->valid)
+                victim = slot;
+        }
+        else if (victim == NULL || (victim->valid && slot->last_use < victim->last_use))
+            victim = slot;
+    }
+
+    // miss: load first page of image into victim slot
+    if (victim == NULL)
+        return NULL;
+    prog_cache_release(victim);
+    victim->inode_num = inode_num;
+    victim->image_len = image_len;
+    victim->nbr_pages = (image_len + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (victim->nbr_pages != 0 && prog_cache_load_page(victim, 0))
+        return NULL;
+
+    victim->valid = 1;
+    victim->fs_generation = exe_info->fs_generation;
+    victim->nbr_text_pages = (victim->nbr_pages == 0) ? 0 : count_text_pages((uint8_t*)victim->frames[0], image_len);
+    victim->last_use = prog_cache_clock;
+    return victim;
+}
+
+/*
+ * prog_cache_map
+ *   DESCRIPTION: maps the image of an executable at USER_IMG_ADDR in the user region of a process, without copying it:
+ *                read-only leading pages are shared, the others are shared copy-on-write (first write gets a private copy).
+ *                image pages not cached yet stay not present and are read on first access, pages past the image
+ *                are left to demand-zero faults
+ *   INPUTS: pid: process whose page table gets the image (see page_user_setup)
+ *           inode_num: inode of executable -- exe_info: validated exec metadata of the executable (see get_exe_info)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may load the first page of the image in the cache, takes a frame reference per page mapped
+ *   RETURN VALUE: 0 = success, -1 = image could not be loaded (out of frames or read failed)
+ */
+int32_t prog_cache_map(uint32_t pid, uint32_t inode_num, const exe_meta_t* exe_info){
+    uint32_t i, flags;
+    prog_cache_slot_t* slot = prog_cache_get(inode_num, exe_info);
+
+    if (slot == NULL || pid >= MAX_PROCESS_CNT)
+        return -1;
+    prog_cache_mappings[pid].inode_num = inode_num;
+    prog_cache_mappings[pid].exe_info = *exe_info;
+    for (i = 0; i < slot->nbr_pages; i++){
+        flags = (i < slot->nbr_text_pages) ? PTE_CONTROL_FLAGS_USER_RO : (PTE_CONTROL_FLAGS_USER_RO | PTE_COW);
+        if (slot->frames[i] != 0)
+            page_user_map_page(pid, USER_IMG_ADDR + i * PAGE_SIZE, slot->frames[i], flags);
+        else
+            page_user_map_file(pid, USER_IMG_ADDR + i * PAGE_SIZE);
+    }
+    return 0;
+}
+
+/*
+ * prog_cache_fault
+ *   DESCRIPTION: fills an image page of a process on its first access: the page is read into the cache if no
+ *                process touched it yet (or its image got evicted), then mapped like prog_cache_map does
+ *   INPUTS: pid: process that faulted -- V_ADDR: faulting virtual address (inside an image page, see page_user_map_file)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may read from the filesystem and allocate frames, takes a frame reference for the mapping
+ *   RETURN VALUE: 0 = page mapped, -1 = page could not be loaded
+ */
+int32_t prog_cache_fault(uint32_t pid, uint32_t V_ADDR){
+    uint32_t page, flags;
+    prog_cache_slot_t* slot;
+
+    if (pid >= MAX_PROCESS_CNT || V_ADDR < USER_IMG_ADDR)
+        return -1;
+    slot = prog_cache_get(prog_cache_mappings[pid].inode_num, &prog_cache_mappings[pid].exe_info);
+    page = (V_ADDR - USER_IMG_ADDR) / PAGE_SIZE;
+    if (slot == NULL || page >= slot->nbr_pages)
+        return -1;
+    if (slot->frames[page] == 0 && prog_cache_load_page(slot, page))
+        return -1;
+    flags = (page < slot->nbr_text_pages) ? PTE_CONTROL_FLAGS_USER_RO : (PTE_CONTROL_FLAGS_USER_RO | PTE_COW);
+    return page_user_map_page(pid, USER_IMG_ADDR + page * PAGE_SIZE, slot->frames[page], flags);
+}
@@ -0,0 +1,54 @@
+/* prog_cache.h - Defines the program image cache shared by processes running the same executable
+ * vim:ts=4 noexpandtab
+ */
+#ifndef PROG_CACHE_H
+#define PROG_CACHE_H
+
+#include "types.h"
+#include "page.h"
+#include "filesystem.h"
+#include "syscall_handlers.h"
+
+#define PROG_CACHE_SLOT_PAGES     ((MAX_FILELENGTH + PAGE_SIZE - 1) / PAGE_SIZE)            // a slot holds the largest image exec loads
+#define PROG_CACHE_NBR_SLOTS      16
+
+// ELF header / program header fields used to find the read-only part of an image
+#define ELF_PHOFF_LOC             28
+#define ELF_PHENTSIZE_LOC         42
+#define ELF_PHNUM_LOC             44
+#define ELF_PHDR_MIN_SIZE         32
+#define ELF_PHDR_TYPE_LOC         0
+#define ELF_PHDR_VADDR_LOC        8
+#define ELF_PHDR_MEMSZ_LOC        20
+#define ELF_PHDR_FLAGS_LOC        24
+#define ELF_PT_LOAD               1
+#define ELF_PF_W                  0x2
+
+/* PROGRAM CACHE SLOT: one executable image loaded once into frames, shared by every process running it */
+typedef struct prog_cache_slot {
+    uint32_t valid;           // slot holds an image
+    uint32_t inode_num;       // inode of executable
+    uint32_t image_len;       // nbr of bytes of image loaded (file length, at most MAX_FILELENGTH)
+    uint32_t fs_generation;   // filesystem generation the image was loaded in (see exe_meta_t)
+    uint32_t nbr_pages;       // nbr of pages holding the image
+    uint32_t nbr_text_pages;  // leading pages of image that are never written: mapped read-only and shared
+    uint32_t last_use;        // for LRU replacement
+    uint32_t busy;            // nbr of tasks reading a page into the slot (read_data may sleep on the disk): not replaced
+    uint32_t frames[PROG_CACHE_SLOT_PAGES];  // physical address of each page, 0 until first touched (slot holds a reference on each frame)
+} prog_cache_slot_t;
+
+/* PROGRAM CACHE MAPPING: executable whose image a process maps (to fill its image pages on fault) */
+typedef struct prog_cache_mapping {
+    uint32_t inode_num;       // inode of executable
+    exe_meta_t exe_info;      // exec metadata of the executable when it was mapped
+} prog_cache_mapping_t;
+
+/* returns the cache slot holding the image of an executable (loads its first page on a miss) */
+prog_cache_slot_t* prog_cache_get(uint32_t inode_num, const exe_meta_t* exe_info);
+/* maps the image of an executable in the user region of a process: text shared read-only, data copy-on-write,
+   pages not cached yet are filled on first access */
+int32_t prog_cache_map(uint32_t pid, uint32_t inode_num, const exe_meta_t* exe_info);
+/* fills and maps an image page of the process on its first access (called by the page fault handler) */
+int32_t prog_cache_fault(uint32_t pid, uint32_t V_ADDR);
+
+#endif /* PROG_CACHE_H */
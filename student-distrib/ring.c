@@ -0,0 +1,103 @@
+/* ring.c - Defines the system call ring: a page shared by a process and the kernel where many
+ *          calls are queued and processed in one kernel entry (submission and completion queues)
+ * vim:ts=4 noexpandtab
+ */
+
+#include "ring.h"
+#include "lib.h"
+#include "page.h"
+#include "frame.h"
+#include "syscall_handlers.h"
+
+/*
+ * ring_setup
+ *   DESCRIPTION: maps a zeroed frame at USER_RING_ADDR in the user region of a process (unless a frame is
+ *                mapped there already) and empties its queues. the mapping is released with the other pages
+ *                of the process when it halts
+ *   INPUTS: pid - pid of the running process
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may allocate a frame, modifies the page table of the process
+ *   RETURN VALUE: 0 (success) or -1 (invalid pid, out of frames)
+ */
+int32_t ring_setup(uint32_t pid){
+    ring_t* ring = (ring_t*)USER_RING_ADDR;
+    uint32_t frame;
+    int32_t present = page_user_present(pid, USER_RING_ADDR);
+
+    if(present < 0)
+        return -1;
+    if(!present){
+        if((frame = frame_alloc()) == 0)
+            return -1;
+        memset((void*)frame, 0, PAGE_SIZE);
+        page_user_map_page(pid, USER_RING_ADDR, frame, PTE_CONTROL_FLAGS_USER);
+        frame_put(frame);           // the mapping holds the reference
+        page_invalidate(USER_RING_ADDR);
+    }
+    ring->sq_head = ring->sq_tail = 0;
+    ring->cq_head = ring->cq_tail = 0;
+    return 0;
+}
+
+/*
+ * ring_do
+ *   DESCRIPTION: runs the system call of a submission entry
+ *   INPUTS: sqe - copy of the submission entry
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: those of the system call
+ *   RETURN VALUE: return value of the system call, -1 for an unknown operation
+ */
+static int32_t ring_do(const ring_sqe_t* sqe){
+    switch(sqe->opcode){
+    case RING_OP_NOP:
+        return 0;
+    case RING_OP_READ:
+        return sys_read(sqe->fd, sqe->buf, sqe->len);
+    case RING_OP_WRITE:
+        return sys_write(sqe->fd, sqe->buf, sqe->len);
+    case RING_OP_OPEN:
+        return sys_open((const uint8_t*)sqe->buf);
+    case RING_OP_CLOSE:
+        return sys_close(sqe->fd);
+    default:
+        return -1;
+    }
+}
+
+/*
+ * ring_enter
+ *   DESCRIPTION: processes the queued submissions of the running process in order, each completion going to the
+ *                completion queue where the program takes it without entering the kernel. stops after to_submit
+ *                submissions, when the submission queue is empty or when the completion queue is full
+ *   INPUTS: pid - pid of the running process (its ring is mapped at USER_RING_ADDR)
+ *           to_submit - max nbr of submissions to process
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: those of the system calls, queues advanced
+ *   RETURN VALUE: nbr of submissions processed, -1 if the process has no ring or its queues are corrupt
+ */
+int32_t ring_enter(uint32_t pid, uint32_t to_submit){
+    ring_t* ring = (ring_t*)USER_RING_ADDR;
+    ring_sqe_t sqe;
+    uint32_t head, tail, cq_tail;
+    int32_t res, nbr_done = 0;
+
+    if(page_user_present(pid, USER_RING_ADDR) != 1)
+        return -1;
+    head = ring->sq_head;
+    tail = ring->sq_tail;
+    if(tail - head > RING_NBR_ENTRIES)
+        return -1;
+    while(head != tail && (uint32_t)nbr_done < to_submit){
+        cq_tail = ring->cq_tail;
+        if(cq_tail - ring->cq_head >= RING_NBR_ENTRIES)   // no room for the completion: the program must take some
+            break;
+        sqe = ring->sq[head & RING_MASK];   // copied: the program cannot change it during the call
+        res = ring_do(&sqe);
+        ring->cq[cq_tail & RING_MASK].user_data = sqe.user_data;
+        ring->cq[cq_tail & RING_MASK].res = res;
+        ring->cq_tail = cq_tail + 1;    // completion visible once filled
+        ring->sq_head = ++head;
+        nbr_done++;
+    }
+    return nbr_done;
+}
@@ -0,0 +1,52 @@
+/* ring.h - Defines the system call ring: a page shared by a process and the kernel where many
+ *          calls are queued and processed in one kernel entry (submission and completion queues)
+ * vim:ts=4 noexpandtab
+ */
+#ifndef RING_H
+#define RING_H
+
+#include "types.h"
+
+// the layout of the ring is shared with user programs (ece391syscall.h)
+#define RING_NBR_ENTRIES      128                      // entries of each queue (power of 2)
+#define RING_MASK             (RING_NBR_ENTRIES - 1)
+
+// operations of a submission entry
+#define RING_OP_NOP           0
+#define RING_OP_READ          1
+#define RING_OP_WRITE         2
+#define RING_OP_OPEN          3
+#define RING_OP_CLOSE         4
+
+/* SUBMISSION ENTRY: one system call queued by the program */
+typedef struct ring_sqe {
+    int32_t opcode;             // RING_OP_*
+    int32_t fd;                 // read, write, close
+    void* buf;                  // read, write: buffer -- open: file name
+    int32_t len;                // read, write: nbr of bytes
+    uint32_t user_data;         // copied to the completion
+} ring_sqe_t;
+
+/* COMPLETION ENTRY: result of a submission entry */
+typedef struct ring_cqe {
+    uint32_t user_data;         // of the submission entry
+    int32_t res;                // return value of the call
+} ring_cqe_t;
+
+/* RING: queues are indexed by free-running counters (entry = counter & RING_MASK). the program produces
+   submissions (sq_tail) and consumes completions (cq_head), the kernel does the opposite */
+typedef struct ring {
+    uint32_t sq_head;           // next submission the kernel takes
+    uint32_t sq_tail;           // next submission the program fills
+    uint32_t cq_head;           // next completion the program takes
+    uint32_t cq_tail;           // next completion the kernel fills
+    ring_sqe_t sq[RING_NBR_ENTRIES];
+    ring_cqe_t cq[RING_NBR_ENTRIES];
+} ring_t;
+
+/* maps the ring page of a process (at USER_RING_ADDR) and empties its queues */
+int32_t ring_setup(uint32_t pid);
+/* processes up to to_submit queued submissions of the running process, returns the nbr processed */
+int32_t ring_enter(uint32_t pid, uint32_t to_submit);
+
+#endif /* RING_H */
@@ -6,6 +6,10 @@
 #include "lib.h"
 #include "types.h"
 #include "i8259.h"
+#include "scheduler.h"
+#include "syscall_handlers.h"
+#include "terminal.h"
+#include "filesystem.h"
 
 #define RTC_RATE_2  0x0F
 #define RTC_RATE_4  0x0E
@@ -32,7 +36,18 @@
 #define UPPER_4_BITS_MASK  0xF0
 #define LOWER_4_BITS_MASK  0x0F
 
-volatile unsigned int interrupt_flag = 0; // keeps track of the interrupts
+/* the hardware always runs at RTC_FREQ_MAX; every rtc fd has its own virtual rate, a divider of it */
+#define RTC_HW_RATE  RTC_RATE_1024
+#define RTC_TICKS_PER_INT(freq)  (RTC_FREQ_MAX / (freq))  // hardware ticks per virtual interrupt
+
+/* true if hardware tick a is at or after b (ticks wrap around) */
+#define RTC_TICK_REACHED(a, b)  ((int32_t)((a) - (b)) >= 0)
+
+volatile unsigned int interrupt_cnt = 0; // nbr of hardware interrupts (the time of the virtual rtcs)
+static volatile unsigned int rtc_wake_cnt = 0; // earliest virtual interrupt a sleeping reader waits for
+static wait_queue_t rtc_wait_queue = WAIT_QUEUE_INITIALIZER; // processes sleeping in rtc_read
+static uint32_t rtc_nbr_open = 0;     // nbr of open rtc files (the irq is masked when none is)
+static fd_arr_entry_t rtc_kernel_fd = {NULL, 0, 0, USED, RTC_FILE_TYPE, RTC_FREQ_2, 0}; // rtc of kernel tests (no process)
 volatile unsigned int init_flag = 0;  // checks if the rtc is initialized
 
 /*
@@ -50,17 +65,14 @@ void rtc_init(void){
   outb( B_val | TURN_ON_BIT_6, CMOS_PORT);  //write the prev value read
   
 
-  /*The default interrupt rate is 2Hz */
-  int rtc_rate = RTC_RATE_2;  
+  /* the hardware runs at the max rate: processes get their rates from rtc_read */
+  int rtc_rate = RTC_HW_RATE;
   outb(RTC_REG_A|DISABLE_NMI, RTC_PORT);  // select register RTC's Register A + disable NMI
   char A_val = inb(CMOS_PORT);  // read current value of register A
   outb(RTC_REG_A|DISABLE_NMI, RTC_PORT);
   outb((A_val & UPPER_4_BITS_MASK) | rtc_rate, CMOS_PORT); //write the prev value read
 
-  enable_irq(RTC_IRQ_PIN); //activate irq pin associated with RTC
-
   init_flag = 1;  // rtc is initialized
-  interrupt_flag = 0; // sets interrupt flag to 0
 }
 
 /*
@@ -72,32 +84,72 @@ void rtc_init(void){
  *   RETURN VALUE: none
  */
 void rtc_inter_handler(void){
-  interrupt_flag = 1; // sets interrupt flag to 1; handles interrupts
+  interrupt_cnt++; // counts the interrupt; handles interrupts
   outb(RTC_REG_C, RTC_PORT); //read register C after interrupt is handle to make sure interrupts happens again
   inb(CMOS_PORT);
+  if (RTC_TICK_REACHED(interrupt_cnt, rtc_wake_cnt)) {  // a reader is due: wake them all, the others sleep again
+    rtc_wake_cnt = interrupt_cnt + RTC_FREQ_MAX;
+    wait_queue_wake(&rtc_wait_queue);
+  }
   send_eoi(RTC_IRQ_PIN); //sends eoi signal to PIC to unmask lower priority interrupts
   // printf("                                           Im in RTC handler\n");
 
 }
 
+/*
+ *  rtc_fd_entry
+ *   DESCRIPTION: finds the fd entry holding the virtual rtc of a file descriptor
+ *   INPUTS: fd  - file descriptor index
+ *   OUTPUTS: none
+ *   RETURN VALUE: fd entry of the running process, or the kernel's rtc when no process runs (tests)
+ */
+static fd_arr_entry_t* rtc_fd_entry(int32_t fd) {
+  if (active_terminals.terminals[active_terminals.current_active_terminal].active_pcb == NULL || fd < 0 || fd >= MAX_OPEN_FILES)
+    return &rtc_kernel_fd;
+  return &active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd];
+}
+
+/*
+ *  rtc_next_int
+ *   DESCRIPTION: finds the next virtual interrupt of a rate: virtual interrupts fall on multiples of
+ *                their period, like those of a hardware divider
+ *   INPUTS: freq - virtual rate (Hz)
+ *   OUTPUTS: none
+ *   RETURN VALUE: hardware tick of the next virtual interrupt
+ */
+static uint32_t rtc_next_int(uint32_t freq) {
+  return (interrupt_cnt | (RTC_TICKS_PER_INT(freq) - 1)) + 1;  // periods are powers of 2
+}
+
 /*
  *  rtc_read
- *   DESCRIPTION: defines the RTC read system which returns 0 only when the interrupt
- *                handler is called
+ *   DESCRIPTION: defines the RTC read system which returns 0 only when the next
+ *                interrupt of the virtual rtc of the fd has occurred
  *   INPUTS: fd  - file descriptor index
  *           buf - buffer for interrupt rate (Hz)
  *           nbytes - number of bytes
  *   OUTPUTS: none
+ *   SIDE EFFECTS: sleeps until the virtual interrupt, other readers of the rtc are not affected
  *   RETURN VALUE: 0 - SUCCESS
  */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes) {
   /** For the real-time clock (RTC), this call should always return 0, 
    * but only after an interrupt has occurred 
-   * (set a flag and wait until the interrupt handler clears it, then return 0) **/
-  interrupt_flag = 0;
-  sti();
-  while (!interrupt_flag) {}  // waits for an interrupt to occur
-  cli();
+   * (sleep until the interrupt handler counts the hardware tick of the next virtual interrupt, then return 0) **/
+  fd_arr_entry_t* entry = rtc_fd_entry(fd);
+  uint32_t flags, due;
+
+  cli_and_save(flags);
+  if (RTC_TICK_REACHED(interrupt_cnt, entry->rtc_next))   // the reader was late: missed interrupts are lost
+    entry->rtc_next = rtc_next_int(entry->rtc_freq);
+  due = entry->rtc_next;
+  while (!RTC_TICK_REACHED(interrupt_cnt, due)) {  // waits for the virtual interrupt to occur
+    if (!RTC_TICK_REACHED(due, rtc_wake_cnt))
+      rtc_wake_cnt = due;                 // the earliest a reader waits for
+    wait_queue_sleep(&rtc_wait_queue);  // asleep: the other tasks run
+  }
+  entry->rtc_next = due + RTC_TICKS_PER_INT(entry->rtc_freq);  // keeps the rate when the reader keeps up
+  restore_flags(flags);
   return 0;
 }
 
@@ -145,6 +197,7 @@ int32_t check_freq(int32_t frequency) {
  *  rtc_write
  *   DESCRIPTION: defines the rtc write system, accepts a 4 byte integer
  *                that specifies the interrupt rate to set period interrupts
+ *                of the virtual rtc of the fd (the hardware rate does not change)
  *   INPUTS: fd  - file descriptor index
  *           buf - buffer for interrupt rate (Hz)
  *           nbytes - number of bytes
@@ -152,6 +205,8 @@ int32_t check_freq(int32_t frequency) {
  *   RETURN VALUE: 0 - SUCCESS/ -1 - FAILURE
  */
 int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
+  fd_arr_entry_t* entry = rtc_fd_entry(fd);
+  uint32_t flags;
   int32_t rtc_rate;
   int32_t rtc_freq;
 
@@ -165,36 +220,65 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
     return -1;
   }
 
-  rtc_rate &= LOWER_4_BITS_MASK;		// ensures that the rate is above 2 and less than 15
-
-  cli();
-  outb(RTC_REG_A|DISABLE_NMI, RTC_PORT);  // select register RTC's Register A + disable NMI
-  char A_val = inb(CMOS_PORT); // read current value of register A
-  outb(RTC_REG_A|DISABLE_NMI, RTC_PORT);
-  outb((A_val & 0xF0) | rtc_rate, CMOS_PORT); // write the prev value
-  sti();
+  cli_and_save(flags);
+  entry->rtc_freq = rtc_freq;
+  entry->rtc_next = rtc_next_int(rtc_freq);
+  restore_flags(flags);
   return 0;
 }
 
 /*
  *  rtc_open
- *   DESCRIPTION: defines the rtc open system, call rtc_init to initialize the rtc
+ *   DESCRIPTION: defines the rtc open system, call rtc_init to initialize the rtc,
+ *                and starts its interrupts for the first open rtc file
  *   INPUTS: filename  - name of the file
  *   OUTPUTS: none
  *   RETURN VALUE: 0 - SUCCESS
  */
 int32_t rtc_open(const uint8_t* filename) {
+  uint32_t flags;
   if (!init_flag) rtc_init();   // calls the rtc_init to initialize the rtc if not done
+  cli_and_save(flags);
+  if (rtc_nbr_open++ == 0) {
+    outb(RTC_REG_C, RTC_PORT);  // drop an interrupt raised while masked, or none would come again
+    inb(CMOS_PORT);
+    enable_irq(RTC_IRQ_PIN); //activate irq pin associated with RTC
+  }
+  restore_flags(flags);
+  return 0;
+}
+
+/*
+ *  rtc_open_fd
+ *   DESCRIPTION: opens the rtc on a file descriptor of the running process: its virtual rtc starts at 2Hz
+ *   INPUTS: fd  - file descriptor index
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 - SUCCESS
+ */
+int32_t rtc_open_fd(int32_t fd) {
+  fd_arr_entry_t* entry = rtc_fd_entry(fd);
+  uint32_t flags;
+
+  rtc_open(NULL);
+  cli_and_save(flags);
+  entry->rtc_freq = RTC_FREQ_2;   // the default interrupt rate is 2Hz
+  entry->rtc_next = rtc_next_int(RTC_FREQ_2);
+  restore_flags(flags);
   return 0;
 }
 
 /*
  *  rtc_close
- *   DESCRIPTION: defines the rtc close system, returns 0
+ *   DESCRIPTION: defines the rtc close system, stops the rtc interrupts when the last rtc file is closed
  *   INPUTS: fd  - file descriptor index
  *   OUTPUTS: none
  *   RETURN VALUE: 0 - SUCCESS
  */
 int32_t rtc_close (int32_t fd) {
+  uint32_t flags;
+  cli_and_save(flags);
+  if (rtc_nbr_open > 0 && --rtc_nbr_open == 0)
+    disable_irq(RTC_IRQ_PIN);   // no reader left: no interrupts at the max rate for nothing
+  restore_flags(flags);
   return 0;
 }
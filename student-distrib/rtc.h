@@ -16,6 +16,7 @@
 #define RTC_REG_C       0x0C
 #define RTC_REG_D       0x0D
 #define TURN_ON_BIT_6   0x40
+#define RTC_FREQ_MAX    1024    // rate of the hardware, the virtual rtc of an fd runs at a divider of it
 
 /* initializes the RTC */
 extern void rtc_init(void);
@@ -32,6 +33,9 @@ extern int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes);
 /* open system for RTC */
 extern int32_t rtc_open(const uint8_t* filename);
 
+/* opens the RTC on a file descriptor of the running process (2Hz) */
+extern int32_t rtc_open_fd(int32_t fd);
+
 /* close system for RTC */
 extern int32_t rtc_close(int32_t fd);
 
@@ -4,118 +4,652 @@
 #include "syscall_handlers.h"
 #include "x86_desc.h"
 #include "page.h"
+#include "timer.h"
+#include "context.h"
+#include "fpu.h"
 
-uint32_t scheduler_saved_esp, scheduler_saved_ebp;
+
+// run queue: multilevel feedback queue, one FIFO of runnable tasks per priority level (0 = highest), linked
+// through pcb->rq_next (the running task is not in it). tasks using whole slices sink, tasks sleeping rise
+static pcb_t* run_queue_head[MLFQ_NBR_LEVELS];
+static pcb_t* run_queue_tail[MLFQ_NBR_LEVELS];
+static const uint32_t mlfq_quantum[MLFQ_NBR_LEVELS] = {PIT_TICK_DIV, 2 * PIT_TICK_DIV, 4 * PIT_TICK_DIV}; // slice of each level, in PIT clocks
+static uint32_t mlfq_boost_clocks = 0;   // PIT clocks since all tasks were last raised to their best level
+static uint32_t charge_clock = 0;        // PIT_now() when the running task was last charged for its slice
+
+static ktimer_t sleep_timers[MAX_PROCESS_CNT]; // timer of each pid, wakes it in sched_sleep
+static context_t task_contexts[MAX_PROCESS_CNT]; // saved context of each pid while it does not run
+
+// a terminal's shell starts on its own stack (left once the shell is in user mode, on its kernel stack)
+static context_t shell_start_context;
+static uint8_t shell_start_stacks[NBR_TERMINALS][PCB_MEM_SPACING] __attribute__((aligned(PCB_MEM_SPACING)));
+
+// idle task: runs (hlt) in the kernel on its own stack when no task is runnable, never in the run queue
+static pcb_t idle_task;
+static uint8_t idle_stack[PCB_MEM_SPACING] __attribute__((aligned(PCB_MEM_SPACING)));
+static uint32_t idle_running = 0;   // idle task has the cpu (the active terminal is the one of the last task)
+static uint32_t idle_started = 0;   // idle task has a saved context
+static context_t idle_context;
+
+// cpu time, in ticks (20 ms) measured with rdtsc: the timer does not tick when a task runs alone or the cpu is idle
+static uint32_t busy_ticks = 0;     // ticks of a task running
+static uint32_t idle_ticks = 0;     // ticks of the idle task running
+static uint64_t account_tsc = 0;    // rdtsc when cpu time was last charged
+static uint32_t account_rem = 0;    // cycles not charged yet (less than a tick)
 
 /* 
- * scheduler
- *   DESCRIPTION: The function the integrates PIT to switch between processes
+ * sched_current
+ *   DESCRIPTION: gives the task having the cpu
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to running task (idle task, or active pcb of active terminal: NULL before the first shell)
+ *   SIDE EFFECTS: none
+ */
+static pcb_t* sched_current(void){
+    if(idle_running)
+        return &idle_task;
+    return active_terminals.terminals[active_terminals.current_active_terminal].active_pcb;
+}
+
+/* 
+ * sched_context
+ *   DESCRIPTION: gives the context a task is saved in when it does not run
+ *   INPUTS: pcb - task
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to context
+ *   SIDE EFFECTS: none
+ */
+static context_t* sched_context(pcb_t* pcb){
+    if(pcb == &idle_task)
+        return &idle_context;
+    return &task_contexts[pcb->pid];
+}
+
+/* 
+ * sched_account
+ *   DESCRIPTION: charges the cpu time since the last call to the running task (busy) or to the idle task,
+ *                called before the running task changes. nothing is charged if the tsc could not be calibrated
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void sched_account(void){
+    pcb_t* current = sched_current();
+    uint64_t now, cycles;
+    uint32_t ticks;
+
+    asm volatile("rdtsc" : "=A" (now));
+    if(PIT_tsc_per_tick == 0 || account_tsc == 0){
+        account_tsc = now;
+        return;
+    }
+    cycles = now - account_tsc + account_rem;
+    account_tsc = now;
+    asm("divl %4" : "=a" (ticks), "=d" (account_rem) : "a" ((uint32_t)cycles), "d" ((uint32_t)(cycles >> 32)), "rm" (PIT_tsc_per_tick));
+    if(idle_running)
+        idle_ticks += ticks;
+    else if(current != NULL){
+        busy_ticks += ticks;
+        current->nbr_ticks += ticks;
+    }
+}
+
+/* 
+ * sched_charge
+ *   DESCRIPTION: charges the time counted by the timer since the last charge to the slice of the running task
+ *                (the timer only runs while tasks compete for the cpu or kernel timers are pending)
+ *   INPUTS: current - running task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: slice of task shortened (down to 0: used up), boost period advanced
+ */
+static void sched_charge(pcb_t* current){
+    uint32_t now = PIT_now();
+    uint32_t used = now - charge_clock;
+
+    charge_clock = now;
+    mlfq_boost_clocks += used;
+    if(current == NULL || current == &idle_task)
+        return;
+    current->slice_left -= (used < current->slice_left) ? used : current->slice_left;
+}
+
+/* 
+ * run_queue_push
+ *   DESCRIPTION: adds a task at the tail of the queue of its priority level
+ *   INPUTS: pcb - task not in the run queue
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: task state set to runnable
+ */
+static void run_queue_push(pcb_t* pcb){
+    pcb->state = TASK_RUNNABLE;
+    pcb->rq_next = NULL;
+    if(run_queue_tail[pcb->priority] == NULL)
+        run_queue_head[pcb->priority] = pcb;
+    else
+        run_queue_tail[pcb->priority]->rq_next = pcb;
+    run_queue_tail[pcb->priority] = pcb;
+}
+
+/* 
+ * run_queue_best
+ *   DESCRIPTION: gives the highest priority level with a runnable task
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: level (0 = highest), MLFQ_NBR_LEVELS if no task is runnable
+ *   SIDE EFFECTS: none
+ */
+static uint32_t run_queue_best(void){
+    uint32_t level;
+    for(level = 0; level < MLFQ_NBR_LEVELS && run_queue_head[level] == NULL; level++);
+    return level;
+}
+
+/* 
+ * run_queue_pop
+ *   DESCRIPTION: removes the task at the head of the highest priority queue with a runnable task
  *   INPUTS: none
  *   OUTPUTS: none
+ *   RETURN VALUE: pointer to task, NULL if no task is runnable
+ *   SIDE EFFECTS: none
+ */
+static pcb_t* run_queue_pop(void){
+    uint32_t level = run_queue_best();
+    pcb_t* pcb;
+    if(level == MLFQ_NBR_LEVELS)
+        return NULL;
+    pcb = run_queue_head[level];
+    run_queue_head[level] = pcb->rq_next;
+    if(run_queue_head[level] == NULL)
+        run_queue_tail[level] = NULL;
+    pcb->rq_next = NULL;
+    return pcb;
+}
+
+/* 
+ * mlfq_boost
+ *   DESCRIPTION: raises every runnable task and the running one to its best level (given by its nice value) with a
+ *                new slice, so tasks sunk to the lowest level are not starved by a stream of interactive tasks
+ *   INPUTS: current - running task (NULL or idle task: none)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: run queue rebuilt
+ */
+static void mlfq_boost(pcb_t* current){
+    pcb_t* head = NULL;
+    pcb_t* tail = NULL;
+    pcb_t* pcb;
+
+    while((pcb = run_queue_pop()) != NULL){  // empty the run queue, highest level first
+        if(tail == NULL)
+            head = pcb;
+        else
+            tail->rq_next = pcb;
+        tail = pcb;
+    }
+    while((pcb = head) != NULL){             // push back in the same order at the best levels
+        head = pcb->rq_next;
+        pcb->priority = pcb->nice;
+        pcb->slice_left = mlfq_quantum[pcb->priority];
+        run_queue_push(pcb);
+    }
+    if(current != NULL && current != &idle_task){
+        current->priority = current->nice;
+        current->slice_left = mlfq_quantum[current->priority];
+    }
+}
+
+/* 
+ * sched_timer_update
+ *   DESCRIPTION: programs the next timer interrupt for a task getting the cpu: the earliest of the end of its slice
+ *                if other tasks are runnable and the next turn of the kernel timer wheel. none if it runs alone or
+ *                is the idle task and no kernel timer is pending (tickless). ticks go on while a terminal has no
+ *                shell yet
+ *   INPUTS: next - task getting the cpu
+ *   OUTPUTS: none
  *   RETURN VALUE: none
+ *   SIDE EFFECTS: PIT programmed or stopped
+ */
+static void sched_timer_update(pcb_t* next){
+    uint32_t count = timer_next_clocks();
+    int32_t i;
+
+    for(i = 0; i < NBR_TERMINALS; i++){
+        if(active_terminals.terminals[i].active == UNUSED && count > PIT_TICK_DIV)
+            count = PIT_TICK_DIV;
+    }
+    if(next != NULL && next != &idle_task && run_queue_best() != MLFQ_NBR_LEVELS && count > next->slice_left)
+        count = next->slice_left; // end of slice (or a part of it: the rest is programmed on the interrupt)
+    if(count == TIMER_NONE)
+        PIT_stop();
+    else
+        PIT_arm(count);
+}
+
+static void schedule(void);
+
+/* 
+ * idle_loop
+ *   DESCRIPTION: body of the idle task: halts the cpu until an interrupt, and gives the cpu to the first task woken
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none (never returns)
+ *   SIDE EFFECTS: none
+ */
+static void idle_loop(void){
+    while(1){
+        cli();
+        if(run_queue_best() != MLFQ_NBR_LEVELS)
+            schedule();
+        else
+            asm volatile("sti \n hlt" : : : "memory"); // interrupts on and halt in one step: no wakeup missed
+    }
+}
+
+/* 
+ * sched_start_shell
+ *   DESCRIPTION: entry point of the context a terminal's shell starts in (on the start stack of the terminal)
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none (never returns: the shell runs in user mode)
+ *   SIDE EFFECTS: none
+ */
+static void sched_start_shell(void){
+    send_eoi(PIT_IRQ_NUM);
+    sys_execute((uint8_t *)"shell");
+    printf("Scheduler: --Error-- this should not print, ever\n");
+    while(1);
+}
+
+/* 
+ * sched_switch
+ *   DESCRIPTION: switches the cpu from the running task to another one: saves the context of the running task
+ *                and resumes the one the next task was saved with (see switch_context). with no next task, starts
+ *                the shell of a terminal instead; the idle task starts at idle_loop the first time.
+ *                every task not running is suspended in this function. the fpu follows lazily (see fpu.c)
+ *   INPUTS: prev         - running task (NULL: nothing to save, first shell at boot)
+ *           next         - task to run (NULL: start a shell)
+ *           new_terminal - terminal of the shell to start when next is NULL
+ *   OUTPUTS: none
+ *   RETURN VALUE: none (returns when prev is scheduled again)
+ *   SIDE EFFECTS: changes the active terminal, tss, page directory and stack
+ */
+static void sched_switch(pcb_t* prev, pcb_t* next, int32_t new_terminal){
+    context_t* prev_context = (prev != NULL) ? sched_context(prev) : NULL;
+
+    sched_account();
+    if(next == NULL){ // terminal has no process yet: run its shell
+        idle_running = 0;
+        active_terminals.current_active_terminal = new_terminal;
+        shell_start_context.esp = (uint32_t)shell_start_stacks[new_terminal] + PCB_MEM_SPACING - 4; // (no return address)
+        shell_start_context.eflags = CONTEXT_EFLAGS_INIT;
+        shell_start_context.eip = (uint32_t)sched_start_shell;
+        fpu_switch(NULL);
+        switch_context(prev_context, &shell_start_context);
+        return;
+    }
+
+    if(next == &idle_task){ // kernel only: keeps terminal, tss and page directory of the last task
+        idle_running = 1;
+        if(!idle_started){
+            idle_started = 1;
+            idle_context.esp = (uint32_t)idle_stack + PCB_MEM_SPACING - 4;
+            idle_context.eflags = CONTEXT_EFLAGS_INIT;
+            idle_context.eip = (uint32_t)idle_loop;
+        }
+    }
+    else{
+        idle_running = 0;
+        // video memory of the new active terminal is already mapped by its own page tables (see page_video_update)
+        active_terminals.current_active_terminal = next->terminal;
+        if(active_terminals.current_active_terminal == active_terminals.current_showing_terminal)
+            update_cursor(active_terminals.terminals[active_terminals.current_active_terminal].screen_x, active_terminals.terminals[active_terminals.current_active_terminal].screen_y);
+
+        // restore next process' tss and page directory (one CR3 write)
+        tss.ss0 = KERNEL_DS; 
+        tss.esp0 = next->kstack_top;
+        page_user_switch(next->pid);
+    }
+
+    fpu_switch(sched_context(next));
+    switch_context(prev_context, sched_context(next));
+}
+
+/* 
+ * schedule
+ *   DESCRIPTION: runs the task at the head of the run queue in place of the running task, which must already be
+ *                queued (preempted, yielding), blocked or idle. runs the idle task if no task is runnable
+ *   INPUTS: none (call with interrupts off)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none (returns when the running task is scheduled again)
+ *   SIDE EFFECTS: may switch tasks
  */
+static void schedule(void){
+    pcb_t* prev = sched_current();
+    pcb_t* next;
 
+    sched_charge(prev);
+    if((next = run_queue_pop()) == NULL)
+        next = &idle_task;
+    next->state = TASK_RUNNING;
+    sched_timer_update(next);
+    if(next != prev)
+        sched_switch(prev, next, 0);
+}
+
+/* 
+ * scheduler
+ *   DESCRIPTION: The function the integrates PIT to switch between processes: starts the shell of each terminal
+ *                (one per tick), then charges the period that ended to the slice of the running task. the task is
+ *                preempted when its slice is used up (and moves down a level) or when a task of a higher level is
+ *                runnable. blocked tasks and terminals waiting for input are not in the run queue and take no time.
+ *                the timer is one-shot: it is programmed again only if tasks compete for the cpu
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
 void scheduler(void){
-    int32_t previous_active_terminal;
-    
-    // check to see if this was the first process to ever run
-    if(active_terminals.terminals[active_terminals.current_active_terminal].active_pcb == NULL){
-        if(active_terminals.terminals[active_terminals.current_active_terminal].active == UNUSED){ // check if this was the first time this terminal has been opened
-            //active_terminals.terminals[active_terminals.current_active_terminal].active = USED;
-            //printf("first terminal call, terminal number: %u\n", active_terminals.current_active_terminal);
-            
-            asm volatile(          
-                "movl %%esp, %0   \n"
-                "movl %%ebp, %1   \n"
-                :"=r"(scheduler_saved_esp), "=r"(scheduler_saved_ebp)
-                : 
-                :"memory"
-            );
-
-            send_eoi(PIT_IRQ_NUM);
-            sys_execute((uint8_t *)"shell");
-            printf("Scheduler: --Error-- this should not print, ever\n");
-            //return;
+    pcb_t* current = sched_current();
+    int32_t i;
+
+    // check to see if a terminal was never opened: start its shell
+    for(i = 0; i < NBR_TERMINALS; i++){
+        if(active_terminals.terminals[i].active == UNUSED && (current != NULL || i == active_terminals.current_active_terminal)){
+            if(current != NULL && current != &idle_task)
+                run_queue_push(current);
+            PIT_arm(PIT_TICK_DIV); // next tick starts the next shell
+            sched_switch(current, NULL, i);
+            return;
         }
-        else{
-            printf("Scheduling - Error: No current active process\n");
-            send_eoi(PIT_IRQ_NUM);
+    }
+    if(current == NULL){
+        printf("Scheduling - Error: No current active process\n");
+        send_eoi(PIT_IRQ_NUM);
+        return;
+    }
+
+    send_eoi(PIT_IRQ_NUM);
+    sched_charge(current);
+    if(mlfq_boost_clocks >= MLFQ_BOOST_PERIOD){
+        mlfq_boost_clocks = 0;
+        mlfq_boost(current);
+    }
+    if(current == &idle_task){ // idle loop runs the first runnable task
+        sched_timer_update(current);
+        return;
+    }
+
+    if(current->slice_left == 0){ // whole slice used: cpu bound, moves down a level
+        if(current->priority < MLFQ_NBR_LEVELS - 1)
+            current->priority++;
+        current->slice_left = mlfq_quantum[current->priority];
+        if(run_queue_best() == MLFQ_NBR_LEVELS){ // only runnable task: keeps the cpu
+            sched_timer_update(current);
             return;
         }
     }
+    else if(run_queue_best() >= current->priority){ // no task of a higher level: keeps the rest of its slice
+        sched_timer_update(current);
+        return;
+    }
+    run_queue_push(current);
+    schedule();
+}
 
-    //save current process' esp/ebp (do we have to save all registers, I think so)
-    asm volatile(          
-        "movl %%esp, %0   \n"
-        "movl %%ebp, %1   \n"
-        :"=r"(active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->user_esp), "=r"(active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->user_ebp)
-        : 
-        :"memory"
-     );
-    
-    previous_active_terminal = active_terminals.current_active_terminal;
-
-    active_terminals.current_active_terminal = (active_terminals.current_active_terminal + 1) % NBR_TERMINALS;
-    
-    // save/swap screen x and y values 
-    // active_terminals.terminals[previous_active_terminal].saved_screen_x = get_screen_x(); 
-    // active_terminals.terminals[previous_active_terminal].saved_screen_y = get_screen_y();
-    //update_screen_x_y(active_terminals.terminals[active_terminals.current_active_terminal].saved_screen_x, active_terminals.terminals[active_terminals.current_active_terminal].saved_screen_y); 
-    //  printf("\nSCHEDULER was called! new active terminal is %u showing is %u", active_terminals.current_active_terminal, active_terminals.current_showing_terminal);
-    //if new active terminal is running in background switch paging of video memory to terminal video page 
-    if(active_terminals.current_active_terminal != active_terminals.current_showing_terminal){
-        //page_vir_phy_map((int)VIDEO_MEM_ADDR,(int)(TERMINAL_1_VIDEO_PAGE_ADDR + active_terminals.current_active_terminal*PAGE_SIZE) ,(int)VIDEO_MEM_SIZE);
-        page_vir_phy_map  (USER_PAGES_VIR_ADDR_START+SIZE_4MB_PAGE, (TERMINAL_1_VIDEO_PAGE_ADDR + active_terminals.current_active_terminal*PAGE_SIZE), PAGE_SIZE);
-        flush_tlb();
-        k_page_vir_phy_map(VIDEO_MEM_ADDR, (TERMINAL_1_VIDEO_PAGE_ADDR + active_terminals.current_active_terminal*PAGE_SIZE), PAGE_SIZE);
-        flush_tlb();
-    }
-    else{ // map virtual video memory to main video memory (show up on screen)
-        page_vir_phy_map  (USER_PAGES_VIR_ADDR_START+SIZE_4MB_PAGE, VIDEO_MEM_ADDR, PAGE_SIZE);
-        flush_tlb();
-        k_page_vir_phy_map(VIDEO_MEM_ADDR, VIDEO_MEM_ADDR, PAGE_SIZE);
-        flush_tlb();
-        update_cursor(active_terminals.terminals[active_terminals.current_active_terminal].screen_x, active_terminals.terminals[active_terminals.current_active_terminal].screen_y);
-    }  
-    
-    // check to see if next terminal is runing a process
-    if(active_terminals.terminals[active_terminals.current_active_terminal].active == UNUSED){
-        //active_terminals.terminals[active_terminals.current_active_terminal].active = USED;
-        //printf("remaining terminal calls, terminal number: %u\n", active_terminals.current_active_terminal);
-
-        asm volatile(          
-            "movl %%esp, %0   \n"
-            "movl %%ebp, %1   \n"
-            :"=r"(scheduler_saved_esp), "=r"(scheduler_saved_ebp)
-            : 
-            :"memory"
-        );
-        
-        send_eoi(PIT_IRQ_NUM);
-        sys_execute((uint8_t *)"shell");
-        // return;
+/* 
+ * sched_yield
+ *   DESCRIPTION: gives the cpu to the next runnable task, the running task stays runnable (at the tail of the run queue).
+ *                returns right away if no other task is runnable
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch tasks
+ */
+void sched_yield(void){
+    uint32_t flags;
+    cli_and_save(flags);
+    if(run_queue_best() != MLFQ_NBR_LEVELS){
+        run_queue_push(sched_current());
+        schedule();
     }
+    restore_flags(flags);
+}
+
+/* 
+ * sched_block
+ *   DESCRIPTION: blocks the running task until sched_wakeup is called on it, and runs the next runnable task.
+ *                call with interrupts off, after checking the condition waited for (else the wakeup may be missed)
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none (returns once woken and scheduled again)
+ *   SIDE EFFECTS: switches tasks
+ */
+void sched_block(void){
+    uint32_t flags;
+    cli_and_save(flags);
+    active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->state = TASK_BLOCKED;
+    schedule();
+    restore_flags(flags);
+}
 
-    // at this point *next_pcb  is active_terminals.terminals[active_terminals.current_active_terminal].active_pcb;*
+/* 
+ * sched_wakeup
+ *   DESCRIPTION: makes a blocked task runnable, does nothing for other tasks. the task waited for input or an event
+ *                (interactive): it goes to the tail of its best level (given by its nice value) with a new slice
+ *   INPUTS: pcb - task to wake (may be NULL)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the running task keeps the cpu until the next timer interrupt: programmed if it was running alone,
+ *                brought within a tick if the woken task has a higher level
+ */
+void sched_wakeup(pcb_t* pcb){
+    pcb_t* current = sched_current();
+    uint32_t flags;
+    if(pcb == NULL)
+        return;
+    cli_and_save(flags);
+    if(pcb->state == TASK_BLOCKED){
+        pcb->priority = pcb->nice;
+        pcb->slice_left = mlfq_quantum[pcb->priority];
+        run_queue_push(pcb);
+        if(current != NULL && current != &idle_task){ // (idle task: the idle loop schedules it)
+            if(PIT_armed() == 0)
+                sched_timer_update(current);
+            else if(pcb->priority < current->priority && PIT_armed() > PIT_TICK_DIV){
+                sched_charge(current);  // charge the part of the period gone, then preempt within a tick
+                PIT_arm((current->slice_left < PIT_TICK_DIV) ? current->slice_left : PIT_TICK_DIV);
+            }
+        }
+    }
+    restore_flags(flags);
+}
 
-    // context switch assembly
-    // switch esp/ebp to next process' K stack
-    // retore next process' tss
-    tss.ss0 = KERNEL_DS; 
-    tss.esp0 = _8MB - (active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->pid * PCB_MEM_SPACING) - _4B; // offset stack pointer by 4 for pcb pointer
+/* 
+ * wait_queue_sleep
+ *   DESCRIPTION: puts the running task to sleep on a wait queue until wait_queue_wake is called on it, and runs the
+ *                next runnable task (or the idle task). call with interrupts off after checking the condition waited
+ *                for, and check it again on return (loop). with no process running yet (kernel tests) waits for the
+ *                next interrupt
+ *   INPUTS: wq - wait queue of the event
+ *   OUTPUTS: none
+ *   RETURN VALUE: none (returns once woken and scheduled again)
+ *   SIDE EFFECTS: switches tasks, counts a voluntary sleep of the task
+ */
+void wait_queue_sleep(wait_queue_t* wq){
+    pcb_t* current = active_terminals.terminals[active_terminals.current_active_terminal].active_pcb;
+    uint32_t flags;
 
-    page_vir_phy_map((int)USER_PAGES_VIR_ADDR_START, (int)(_8MB + active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->pid * SIZE_4MB_PAGE) , 1);
-    flush_tlb();
+    cli_and_save(flags);
+    if(current == NULL){
+        asm volatile("sti \n hlt \n cli" : : : "memory");
+        restore_flags(flags);
+        return;
+    }
+    current->wq_next = NULL;
+    if(wq->tail == NULL)
+        wq->head = current;
+    else
+        wq->tail->wq_next = current;
+    wq->tail = current;
+    current->nbr_sleeps++;
+    sched_block();
+    restore_flags(flags);
+}
 
-    send_eoi(PIT_IRQ_NUM);
-    
-    asm volatile(          
-        "movl %0, %%esp   \n"
-        "movl %1, %%ebp  \n"
-        :
-        :"r"(active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->user_esp), "r"(active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->user_ebp) 
-        :"esp", "ebp"
-     );
-
-    return; // shouldn't really get here
+/* 
+ * wait_queue_wake
+ *   DESCRIPTION: wakes every task sleeping on a wait queue (in the order they went to sleep), safe in interrupt handlers
+ *   INPUTS: wq - wait queue of the event
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: tasks made runnable, wait queue emptied
+ */
+void wait_queue_wake(wait_queue_t* wq){
+    pcb_t* pcb;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    while((pcb = wq->head) != NULL){
+        wq->head = pcb->wq_next;
+        pcb->wq_next = NULL;
+        sched_wakeup(pcb);
+    }
+    wq->tail = NULL;
+    restore_flags(flags);
+}
+
+/* 
+ * sched_get_stats
+ *   DESCRIPTION: gives the cpu time (PIT ticks) spent running tasks and idle, and the time and sleeps of the running task
+ *   INPUTS: stats - filled with the statistics
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void sched_get_stats(cpu_stats_t* stats){
+    pcb_t* current = sched_current();
+    uint32_t flags;
+
+    cli_and_save(flags);
+    sched_account();
+    stats->busy_ticks = busy_ticks;
+    stats->idle_ticks = idle_ticks;
+    stats->task_ticks = (current != NULL) ? current->nbr_ticks : 0;
+    stats->task_sleeps = (current != NULL) ? current->nbr_sleeps : 0;
+    restore_flags(flags);
+}
+
+/* 
+ * sched_task_init
+ *   DESCRIPTION: sets up the scheduling of a new process, which runs in place of its parent (or is a terminal's
+ *                first shell): running in the active terminal at the best level of its nice value (inherited)
+ *   INPUTS: pcb    - new process
+ *           parent - its parent (NULL: none)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void sched_task_init(pcb_t* pcb, pcb_t* parent){
+    sched_account(); // time so far is the parent's
+    sched_charge(parent);
+    pcb->terminal = active_terminals.current_active_terminal;
+    pcb->state = TASK_RUNNING;
+    pcb->nice = (parent != NULL) ? parent->nice : NICE_DEFAULT;
+    pcb->priority = pcb->nice;
+    pcb->slice_left = mlfq_quantum[pcb->priority];
+    fpu_release(&task_contexts[pcb->pid]);   // new program: fpu initialized on its first use
+    fpu_switch(&task_contexts[pcb->pid]);
+}
+
+/* 
+ * sched_task_exit
+ *   DESCRIPTION: called when a process halts: its parent (if any) runs in its place with the fpu it owns
+ *   INPUTS: pcb - process halting (running)
+ *           parent - its parent, NULL for a shell
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: fpu state of the process dropped
+ */
+void sched_task_exit(pcb_t* pcb, pcb_t* parent){
+    fpu_release(&task_contexts[pcb->pid]);
+    if(parent != NULL)
+        fpu_switch(&task_contexts[parent->pid]);
+}
+
+/* 
+ * sched_current_context
+ *   DESCRIPTION: gives the context of the running task (its fpu state, for the device not available trap)
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to context, NULL if no task runs yet
+ *   SIDE EFFECTS: none
+ */
+context_t* sched_current_context(void){
+    pcb_t* current = sched_current();
+    if(current == NULL)
+        return NULL;
+    return sched_context(current);
+}
+
+/* 
+ * sched_set_nice
+ *   DESCRIPTION: sets the nice value of the running task: its best level, so a higher value keeps it below the
+ *                interactive tasks. takes effect on its current level right away if it is above the new best level
+ *   INPUTS: nice - NICE_MIN to NICE_MAX
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 = success, -1 = invalid value or no task running
+ *   SIDE EFFECTS: none
+ */
+int32_t sched_set_nice(int32_t nice){
+    pcb_t* current = sched_current();
+    uint32_t flags;
+
+    if(nice < NICE_MIN || nice > NICE_MAX || current == NULL || current == &idle_task)
+        return -1;
+    cli_and_save(flags);
+    current->nice = nice;
+    if(current->priority < (uint32_t)nice){
+        current->priority = nice;
+        current->slice_left = mlfq_quantum[current->priority];
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/* 
+ * sched_sleep_expired
+ *   DESCRIPTION: sleep timer of a task expired: wakes it
+ *   INPUTS: data - pcb of task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: task made runnable
+ */
+static void sched_sleep_expired(void* data){
+    sched_wakeup((pcb_t*)data);
+}
+
+/* 
+ * sched_sleep
+ *   DESCRIPTION: puts the running task to sleep for a time: its own kernel timer wakes it, so any number of tasks
+ *                sleep for independent times
+ *   INPUTS: ms - time in milliseconds (rounded up to the wheel's ms, at least 1)
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 = success, -1 = no task running
+ *   SIDE EFFECTS: switches tasks, counts a voluntary sleep of the task
+ */
+int32_t sched_sleep(uint32_t ms){
+    pcb_t* current = sched_current();
+    uint32_t flags;
+
+    if(current == NULL || current == &idle_task)
+        return -1;
+    cli_and_save(flags);
+    timer_add(&sleep_timers[current->pid], ms, sched_sleep_expired, current);
+    current->nbr_sleeps++;
+    while(sleep_timers[current->pid].pending)
+        sched_block();
+    restore_flags(flags);
+    return 0;
 }
@@ -4,8 +4,53 @@
 #include "types.h"
 #include "lib.h"
 #include "pit.h"
+#include "syscall_handlers.h"
+#include "context.h"
 
-extern uint32_t scheduler_saved_esp, scheduler_saved_ebp;
+// states of a task (pcb state field)
+#define TASK_RUNNING      0   // running on the cpu (the active pcb of the active terminal)
+#define TASK_RUNNABLE     1   // waiting in the run queue
+#define TASK_BLOCKED      2   // waiting for an event (input, child process), not in the run queue
 
+// multilevel feedback queue: levels of priority (0 = highest), slices grow from 1 to 4 ticks (20 ms) down the levels
+#define MLFQ_NBR_LEVELS   3
+#define MLFQ_BOOST_PERIOD (50 * PIT_TICK_DIV)  // PIT clocks (1s, counted while tasks compete) between raises of every task to its best level
+
+// nice value of a task: its best level (the level it starts at, and goes back to when it sleeps)
+#define NICE_MIN          0
+#define NICE_MAX          (MLFQ_NBR_LEVELS - 1)
+#define NICE_DEFAULT      NICE_MIN
+
+/* WAIT QUEUE: tasks sleeping until an event (linked through pcb->wq_next) */
+typedef struct wait_queue {
+    pcb_t* head;
+    pcb_t* tail;
+} wait_queue_t;
+
+#define WAIT_QUEUE_INITIALIZER    { NULL, NULL }
+
+/* PIT tick: starts the shells of the terminals, preempts the running task if another one is runnable */
 void scheduler(void);
+/* gives the cpu to the next runnable task, the running task stays runnable */
+void sched_yield(void);
+/* blocks the running task until sched_wakeup, runs the next runnable task (call with interrupts off) */
+void sched_block(void);
+/* makes a blocked task runnable */
+void sched_wakeup(pcb_t* pcb);
+/* puts the running task to sleep on a wait queue until wait_queue_wake (call with interrupts off) */
+void wait_queue_sleep(wait_queue_t* wq);
+/* wakes every task sleeping on a wait queue */
+void wait_queue_wake(wait_queue_t* wq);
+/* sets up the scheduling of a new process (nice value inherited from parent) */
+void sched_task_init(pcb_t* pcb, pcb_t* parent);
+/* called when a process halts, before its parent runs in its place */
+void sched_task_exit(pcb_t* pcb, pcb_t* parent);
+/* gives the context of the running task (NULL if none) */
+context_t* sched_current_context(void);
+/* sets the nice value of the running task */
+int32_t sched_set_nice(int32_t nice);
+/* puts the running task to sleep for ms milliseconds */
+int32_t sched_sleep(uint32_t ms);
+/* gives the busy/idle cpu time and the time and sleeps of the running task */
+void sched_get_stats(cpu_stats_t* stats);
 #endif /* SCHEDULER_H */
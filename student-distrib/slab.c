@@ -0,0 +1,149 @@
+/* slab.c - Defines the slab allocator for kernel objects (pcbs, fd tables, ...)
+ * vim:ts=4 noexpandtab
+ */
+
+#include "slab.h"
+#include "lib.h"
+
+/*
+ * slab_list_remove
+ *   DESCRIPTION: unlinks a slab from a list of its cache
+ *   INPUTS: head: pointer to head of list -- slab: slab in list
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: modifies list
+ *   RETURN VALUE: none
+ */
+static void slab_list_remove(slab_t** head, slab_t* slab){
+    if (slab->prev != NULL)
+        slab->prev->next = slab->next;
+    else
+        *head = slab->next;
+    if (slab->next != NULL)
+        slab->next->prev = slab->prev;
+    slab->prev = slab->next = NULL;
+}
+
+/*
+ * slab_list_push
+ *   DESCRIPTION: links a slab at the head of a list of its cache
+ *   INPUTS: head: pointer to head of list -- slab: slab not in any list
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: modifies list
+ *   RETURN VALUE: none
+ */
+static void slab_list_push(slab_t** head, slab_t* slab){
+    slab->prev = NULL;
+    slab->next = *head;
+    if (*head != NULL)
+        (*head)->prev = slab;
+    *head = slab;
+}
+
+/*
+ * slab_grow
+ *   DESCRIPTION: gives a new slab to a cache: a frame with the slab header, then every object on the free list
+ *   INPUTS: cache: cache to grow
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: allocates a frame, adds a slab to the partial list
+ *   RETURN VALUE: pointer to slab or NULL if out of frames
+ */
+static slab_t* slab_grow(slab_cache_t* cache){
+    uint32_t i, obj;
+    slab_t* slab;
+
+    if (cache->objs_per_slab == 0 || (slab = (slab_t*)frame_alloc()) == NULL)
+        return NULL;
+    slab->cache = cache;
+    slab->nbr_used = 0;
+    slab->free_list = NULL;
+    for (i = cache->objs_per_slab; i > 0; i--){   // lowest object first on the free list
+        obj = (uint32_t)slab + SLAB_HDR_SIZE + (i - 1) * cache->obj_size;
+        *(void**)obj = slab->free_list;
+        slab->free_list = (void*)obj;
+    }
+    slab_list_push(&cache->partial, slab);
+    cache->nbr_slabs++;
+    return slab;
+}
+
+/*
+ * slab_alloc
+ *   DESCRIPTION: allocates an object of a cache in constant time: taken from the first slab with free objects,
+ *                or from a new slab if every slab is full. the object is not cleared
+ *   INPUTS: cache: cache of object type
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may allocate a frame, updates statistics
+ *   RETURN VALUE: pointer to object (aligned to a cache line) or NULL if out of memory
+ */
+void* slab_alloc(slab_cache_t* cache){
+    uint32_t flags;
+    slab_t* slab;
+    void* obj;
+
+    if (cache == NULL)
+        return NULL;
+    cli_and_save(flags);
+    if ((slab = cache->partial) == NULL && (slab = slab_grow(cache)) == NULL){
+        cache->nbr_failed++;
+        restore_flags(flags);
+        return NULL;
+    }
+    obj = slab->free_list;
+    slab->free_list = *(void**)obj;
+    if (++slab->nbr_used == cache->objs_per_slab){  // slab now full
+        slab_list_remove(&cache->partial, slab);
+        slab_list_push(&cache->full, slab);
+    }
+    cache->nbr_active++;
+    cache->nbr_allocs++;
+    restore_flags(flags);
+    return obj;
+}
+
+/*
+ * slab_free
+ *   DESCRIPTION: frees an object allocated by slab_alloc in constant time (its slab is the frame holding it).
+ *                a slab left empty goes back to the frame pool unless it is the only slab with free objects
+ *   INPUTS: obj: pointer to object (NULL is ignored)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may free a frame, updates statistics
+ *   RETURN VALUE: none
+ */
+void slab_free(void* obj){
+    uint32_t flags;
+    slab_t* slab;
+    slab_cache_t* cache;
+
+    if (obj == NULL)
+        return;
+    slab = (slab_t*)((uint32_t)obj & ~(FRAME_SIZE - 1));
+    cache = slab->cache;
+    cli_and_save(flags);
+    if (slab->nbr_used-- == cache->objs_per_slab){  // slab was full
+        slab_list_remove(&cache->full, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+    *(void**)obj = slab->free_list;
+    slab->free_list = obj;
+    cache->nbr_active--;
+    cache->nbr_frees++;
+    if (slab->nbr_used == 0 && (slab->prev != NULL || slab->next != NULL)){  // empty and not the last partial slab
+        slab_list_remove(&cache->partial, slab);
+        cache->nbr_slabs--;
+        frame_put((uint32_t)slab);
+    }
+    restore_flags(flags);
+}
+
+/*
+ * slab_print_stats
+ *   DESCRIPTION: prints the statistics of a cache
+ *   INPUTS: cache: cache
+ *   OUTPUTS: one line on the screen
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: none
+ */
+void slab_print_stats(const slab_cache_t* cache){
+    printf("slab %s: size %u, %u active, %u slabs, %u allocs, %u frees, %u failed\n", cache->name, cache->obj_size,
+           cache->nbr_active, cache->nbr_slabs, cache->nbr_allocs, cache->nbr_frees, cache->nbr_failed);
+}
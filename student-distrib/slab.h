@@ -0,0 +1,51 @@
+/* slab.h - Defines the slab allocator for kernel objects (pcbs, fd tables, ...)
+ * vim:ts=4 noexpandtab
+ */
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "types.h"
+#include "frame.h"
+
+// objects are aligned (and their size rounded) to a cache line so two objects never share one
+#define SLAB_CACHE_LINE           64
+#define SLAB_ALIGN(size)          (((size) + SLAB_CACHE_LINE - 1) & ~(SLAB_CACHE_LINE - 1))
+#define SLAB_HDR_SIZE             SLAB_ALIGN(sizeof(slab_t))
+#define SLAB_OBJS_PER_SLAB(size)  ((FRAME_SIZE - SLAB_HDR_SIZE) / SLAB_ALIGN(size))
+
+/* static initializer of a cache of objects of type obj_type (objects must fit in a frame with the slab header) */
+#define SLAB_CACHE_INITIALIZER(cache_name, obj_type) \
+    { cache_name, SLAB_ALIGN(sizeof(obj_type)), SLAB_OBJS_PER_SLAB(sizeof(obj_type)), NULL, NULL, 0, 0, 0, 0, 0 }
+
+/* SLAB: one frame holding a header (this struct) followed by objects of one cache */
+typedef struct slab {
+    struct slab* prev;          // in partial or full list of cache
+    struct slab* next;
+    struct slab_cache* cache;   // cache owning the slab
+    void* free_list;            // free objects of slab, linked through their first word
+    uint32_t nbr_used;          // nbr of objects allocated from slab
+} slab_t;
+
+/* SLAB CACHE: allocates objects of one type */
+typedef struct slab_cache {
+    const int8_t* name;         // name of object type (for stats)
+    uint32_t obj_size;          // size of an object, rounded to a cache line
+    uint32_t objs_per_slab;     // nbr of objects in a slab
+    slab_t* partial;            // slabs with free objects (allocations come from the first one)
+    slab_t* full;               // slabs with no free object
+    // statistics
+    uint32_t nbr_slabs;         // nbr of slabs (frames) held
+    uint32_t nbr_active;        // nbr of objects allocated
+    uint32_t nbr_allocs;        // total nbr of allocations
+    uint32_t nbr_frees;         // total nbr of frees
+    uint32_t nbr_failed;        // nbr of allocations that failed (out of frames)
+} slab_cache_t;
+
+/* allocates an object of a cache in constant time, returns NULL if out of memory */
+void* slab_alloc(slab_cache_t* cache);
+/* frees an object allocated by slab_alloc in constant time */
+void slab_free(void* obj);
+/* prints the statistics of a cache */
+void slab_print_stats(const slab_cache_t* cache);
+
+#endif /* SLAB_H */
@@ -10,6 +10,11 @@
 #include "x86_desc.h"
 #include "tests.h"
 #include "scheduler.h"
+#include "prog_cache.h"
+#include "ring.h"
+#include "page_cache.h"
+#include "frame.h"
+#include "slab.h"
 
 // define file operation tables for each type of file
 static file_op_table_t op_table_reg_file = {open_file, close_file, read_file, write_file};
@@ -19,7 +24,67 @@ static file_op_table_t op_table_rtc_file = {rtc_open, rtc_close, rtc_read, rtc_w
 static file_op_table_t op_table_stdin    = {open_bad_call, close_bad_call, terminal_read, write_bad_call};
 static file_op_table_t op_table_stdout   = {open_bad_call, close_bad_call, read_bad_call, terminal_write};
 
-static int pcb_allocated[MAX_PROCESS_CNT]; // keeps track of PIDs allocated
+// pcbs and their fd arrays are kernel objects allocated from slab caches
+static slab_cache_t pcb_cache      = SLAB_CACHE_INITIALIZER("pcb", pcb_t);
+static slab_cache_t fd_table_cache = SLAB_CACHE_INITIALIZER("fd table", fd_arr_entry_t[MAX_OPEN_FILES]);
+// pids: released ones are reused first (stack), the others are handed out in order
+static uint32_t free_pids[MAX_PROCESS_CNT];
+static uint32_t nbr_free_pids = 0;
+static uint32_t next_pid = 0;
+static uint32_t pid_kstacks[MAX_PROCESS_CNT]; // kernel stack of each pid, allocated on its first exec
+
+/*
+ * process_alloc
+ *   DESCRIPTION: allocates a pid, a pcb and its fd array in constant time (pcb and fd array are cleared)
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: takes a pid, allocates from the pcb and fd table caches
+ *   RETURN VALUE: pointer to pcb (pid set) or NULL if every pid is used or out of memory
+ */
+static pcb_t* process_alloc(void){
+     uint32_t flags, pid;
+     pcb_t* pcb;
+     fd_arr_entry_t* fd_arr;
+
+     cli_and_save(flags);
+     if(nbr_free_pids == 0 && next_pid == MAX_PROCESS_CNT){
+          restore_flags(flags);
+          return NULL;
+     }
+     pcb = (pcb_t*)slab_alloc(&pcb_cache);
+     fd_arr = (fd_arr_entry_t*)slab_alloc(&fd_table_cache);
+     if(pcb == NULL || fd_arr == NULL){
+          slab_free(pcb);
+          slab_free(fd_arr);
+          restore_flags(flags);
+          return NULL;
+     }
+     pid = (nbr_free_pids != 0) ? free_pids[--nbr_free_pids] : next_pid++;
+     restore_flags(flags);
+
+     memset(pcb, 0, sizeof(pcb_t));
+     memset(fd_arr, 0, sizeof(fd_arr_entry_t) * MAX_OPEN_FILES);
+     pcb->pid = pid;
+     pcb->fd_arr = fd_arr;
+     return pcb;
+}
+
+/*
+ * process_free
+ *   DESCRIPTION: releases the pid, pcb and fd array of a process in constant time
+ *   INPUTS: pcb: pcb allocated by process_alloc
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: pcb must not be used anymore
+ *   RETURN VALUE: none
+ */
+static void process_free(pcb_t* pcb){
+     uint32_t flags;
+     cli_and_save(flags);
+     free_pids[nbr_free_pids++] = pcb->pid;
+     slab_free(pcb->fd_arr);
+     slab_free(pcb);
+     restore_flags(flags);
+}
 //pcb_t* current_process_pcb = NULL; //keeps track of current process's pcb
 //static int first_time_called = 1;
 
@@ -34,6 +99,7 @@ static int pcb_allocated[MAX_PROCESS_CNT]; // keeps track of PIDs allocated
 int32_t sys_halt(uint8_t status){
      pcb_t* parent_process; 
      pcb_t* current_process_pcb;
+     uint32_t nbr_faults, nbr_image_faults;
      
      //printf("\n I am trying to halt in terminal %u \n", active_terminals.current_active_terminal);
      current_process_pcb = active_terminals.terminals[active_terminals.current_active_terminal].active_pcb;
@@ -56,27 +122,33 @@ int32_t sys_halt(uint8_t status){
              sys_close(i); //call close on open files
      }
      current_process_pcb->active = UNUSED;
-     // remove current process from active tracking
-     pcb_allocated[current_process_pcb->pid] = 0;
+     if(PRINT_EXEC_FAULTS && !page_user_fault_counts(current_process_pcb->pid, &nbr_faults, &nbr_image_faults))
+          printf("pid %u: %u page faults (%u on image pages)\n", current_process_pcb->pid, nbr_faults, nbr_image_faults);
+     if(PRINT_EXEC_SLEEPS)
+          printf("pid %u: %u voluntary sleeps\n", current_process_pcb->pid, current_process_pcb->nbr_sleeps);
+     page_user_teardown(current_process_pcb->pid); // release user pages (tlb flushed once parent or new shell is mapped)
+
+     sched_task_exit(current_process_pcb, parent_process);
 
      if (current_process_pcb->parent_pcb == NULL) {
-          // save esp and ebp to prevent overwite
-          scheduler_saved_esp = active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->user_esp;
-          scheduler_saved_ebp = active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->user_ebp;
           // reset active flags to initalized state
           active_terminals.terminals[active_terminals.current_active_terminal].active_pcb = NULL;
           active_terminals.terminals[active_terminals.current_active_terminal].active = UNUSED;
+     }
+
+     if (parent_process == NULL) {
+          process_free(current_process_pcb); // remove current process from active tracking: pid, pcb and fd array are released
           printf("Cannot halt base shell\n");
           sys_execute((uint8_t*)"shell");
      }
      //printf("Halt: passed parrent NULL check\n");
    
      // unmap current process + map parent process
-     page_vir_phy_map((int)USER_PAGES_VIR_ADDR_START, (int)(_8MB + parent_process->pid * SIZE_4MB_PAGE) , 1); // allocate 4k page at 128MB
-     //page_vir_phy_unmap(USER_PAGES_VIR_ADDR_START+SIZE_4MB_PAGE); // unmap user video memory if perviously mapped
-     flush_tlb();
+     page_user_switch(parent_process->pid); // load parent's page directory
      
      active_terminals.terminals[active_terminals.current_active_terminal].active_pcb = parent_process;
+     parent_process->state = TASK_RUNNING; // parent runs in place of the child
+     process_free(current_process_pcb); // remove current process from active tracking: pid, pcb and fd array are released
      
      //printf("\nrestored user ebp and esp %x and %x: \n", parent_process->user_ebp, parent_process->user_esp);
      //printf("\nrestored tss esp0: %x\n", parent_process->tss_esp0);
@@ -124,10 +196,10 @@ int32_t sys_execute(const uint8_t *command){
      uint8_t args[MAX_ARG_LEN];
      uint32_t filename_len, i, free_pid;
      uint32_t arg_start;
-     uint8_t eip_buf[_4B]; // buffer to hold the 32bit eip pointer from the file
      uint32_t instructions_start, user_stack;
      pcb_t* new_pcb;
      dentry_t file_dentry;
+     exe_meta_t exe_info;
 
      if (command == NULL){
           return -1;
@@ -159,47 +231,34 @@ int32_t sys_execute(const uint8_t *command){
      for(index= filename_len; index <MAX_FILENAME_LEN; index ++ ) //zero padding filename
           filename[index] = '\0';
 
-     // check if file passed is valid: present and executable
-     if(is_file_executable(filename)){ // returns 0 if executable
-          printf("file: \"%s\" is not excecutable\n");
+     // check if file passed is valid: present and executable, and get its dentry and entry point (cached per inode)
+     if(get_exe_info(filename, &file_dentry, &exe_info)){ // returns 0 if executable
+          printf("file: \"%s\" is not excecutable\n", filename);
           return -1;                   // not executable
      }
+     instructions_start = exe_info.entry_point;
 
-     if(read_dentry_by_name((uint8_t*)filename, &file_dentry) == -1){
-          printf("Error, file not found in dentries\n");
+     // allocate pid, PCB and fd array (don't allow it to be stopped)
+     if((new_pcb = process_alloc()) == NULL){
+          printf("Error, maximum number of processes already running\n");
           return -1;
      }
-     
-     //read instruction start from file
-     if(read_data(file_dentry.inode_num, (uint32_t)EIP_FILE_LOC, eip_buf, (uint32_t)_4B) != _4B){ // 4 = read all 4B of the EIP pointer EIP_FILE_LOC
-          printf("Error reading eip from file\n"); 
+     free_pid = new_pcb->pid;
+     // get the kernel stack of the pid, allocated once from the frame pool
+     if(pid_kstacks[free_pid] == 0 && (pid_kstacks[free_pid] = frame_alloc_contig(KSTACK_NBR_FRAMES)) == 0){
+          process_free(new_pcb);
+          printf("Execute: --Error-- out of memory for kernel stack\n");
           return -1;
      }
-     instructions_start = *(uint32_t*)eip_buf;
-     free_pid = -1;
-
-     // find an empty memory location for the PCB and set it up (don't allow it to be stopped)
-     for(i = 0; i < MAX_PROCESS_CNT; i++){
-          if(pcb_allocated[i] == 0){
-               pcb_allocated[i] = 1;
-               free_pid = i;
-               break;
-          }
-     }
-     //printf("free_pid = %d\n", free_pid);
-     if(free_pid == -1){  // if no free fd is found
-          printf("Error, maximum number of processes already running\n");
+
+     // setup the pages of the user program: image mapped from the program cache (no copy), rest of the 4MB demand-zero
+     if(page_user_setup(free_pid, active_terminals.current_active_terminal) || prog_cache_map(free_pid, (uint32_t)file_dentry.inode_num, &exe_info)){
+          page_user_teardown(free_pid);
+          process_free(new_pcb);
+          printf("Execute: --Error-- out of memory loading \"%s\"\n", filename);
           return -1;
      }
-     // calculate the memroy location of the PCB and cast as pointer
-     new_pcb = (pcb_t*)(_8MB - (free_pid + 1) * PCB_MEM_SPACING);
-
-     // setup the page the user program
-     page_vir_phy_map((int)USER_PAGES_VIR_ADDR_START, (int)(_8MB + free_pid * SIZE_4MB_PAGE) , 1); // allocate 4k page at 128MB
-     flush_tlb();
-
-     // copy file contennts (exe image) to the correct virtual memory location
-     read_data(file_dentry.inode_num, 0, (uint8_t*)USER_IMG_ADDR, MAX_FILELENGTH); // Limit the read to the free space in the page for the program
+     page_user_switch(free_pid); // load page directory
 
      /* --------- setup pcb --------- */
      // setup stdin and stdout
@@ -210,10 +269,11 @@ int32_t sys_execute(const uint8_t *command){
 
      user_stack = USER_PAGES_VIR_ADDR_START + SIZE_4MB_PAGE; // subtract 4 so we are in the same page (zero counting correction)
         
-     new_pcb->pid = free_pid;             // fill in pcb fields
+     new_pcb->kstack_top = pid_kstacks[free_pid] + PCB_MEM_SPACING - _4B; // fill in pcb fields (offset stack pointer by 4)
      new_pcb->user_esp = user_stack -4;
      new_pcb->file_inode_nbr = (uint32_t)file_dentry.inode_num; 
      new_pcb->active = USED;
+     sched_task_init(new_pcb, active_terminals.terminals[active_terminals.current_active_terminal].active_pcb); // runs in place of its parent
      //new_pcb->user_eip = instructions_start;
 
      //assign intercepted user return address(eip) and top of user stack pointer (esp)  
@@ -237,6 +297,7 @@ int32_t sys_execute(const uint8_t *command){
           //printf("\nsaved user ebp and esp %x and %x: \n", my_parent->user_ebp, my_parent->user_esp);
           // printf("in execute: saved ebp and esp: %u, %u",my_parent->user_ebp )
           my_parent->tss_esp0 = tss.esp0;
+          my_parent->state = TASK_BLOCKED; // parent waits for the child to halt (child runs in its place)
           //printf("\nsaved tss esp0: %x\n", my_parent->tss_esp0);
 
      }
@@ -245,14 +306,12 @@ int32_t sys_execute(const uint8_t *command){
           if(active_terminals.terminals[active_terminals.current_active_terminal].active == UNUSED){ // if first shell in a terminal
                //printf("we should see this once per terminal\n");
                active_terminals.terminals[active_terminals.current_active_terminal].active = USED;
-               new_pcb->user_esp = scheduler_saved_esp;
-               new_pcb->user_ebp = scheduler_saved_ebp;
           }
      }
      
      // prepare tss for context switch (specify kernal data segment and assign esp to the current process's stack)
      tss.ss0 = KERNEL_DS;
-     tss.esp0 = (_8MB - new_pcb->pid * PCB_MEM_SPACING) - _4B; // offset stack pointer by 4 for pcb pointer
+     tss.esp0 = new_pcb->kstack_top;
 
      // clear args before copy
      for(i =0; i < MAX_ARG_LEN; i++){
@@ -335,18 +394,21 @@ int32_t sys_open(const uint8_t *filename)
      // set up fd arr entry for newly opened file
      active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[free_fd].inode_num = file_dentry.inode_num;
      active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[free_fd].file_position = 0; // set read cursor to begining of file
+     active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[free_fd].file_type = file_dentry.filetype; // cache type so fops don't look it up again
      active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[free_fd].flags = USED;      // set fd arr entry to used
 
      switch (file_dentry.filetype)   //assign file operation table according to file type
      {
      case REGULAR_FILE_TYPE:
           active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[free_fd].file_op_table_ptr = &op_table_reg_file;
+          page_cache_open(&active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[free_fd]); // no page or read-ahead yet
           break;
      case DIRECTORY_FILE_TYPE:
           active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[free_fd].file_op_table_ptr = &op_table_dir_file;
           break;
      case RTC_FILE_TYPE:
           active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[free_fd].file_op_table_ptr = &op_table_rtc_file;
+          rtc_open_fd(free_fd);   // own virtual rtc at 2Hz
           break;
      default:
           printf("\n NO FILE TYPE IS MATCHING \n");
@@ -360,7 +422,7 @@ int32_t sys_open(const uint8_t *filename)
  *   DESCRIPTION: close system call invoked in kernel
  *   INPUTS: fd: file descriptor (index to desc table where open file is stored)
  *   OUTPUTS: none
- *   SIDE EFFECTS: sets specified file desc arr entry to UNUSED
+ *   SIDE EFFECTS: calls specific close function of the file, sets specified file desc arr entry to UNUSED
  *   RETURN VALUE: 0 (success) or -1 (failure)
  */
 int32_t sys_close(int32_t fd){
@@ -369,6 +431,8 @@ int32_t sys_close(int32_t fd){
      if (active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].flags == UNUSED)
           return -1; // file is not open
 
+     active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].file_op_table_ptr->close(fd);
+
      active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].flags = UNUSED; //set open file slot to unused 
      return 0;
 }
@@ -455,11 +519,11 @@ int32_t sys_vidmap(uint8_t **screen_start){
      if(((uint32_t)screen_start < USER_PAGES_VIR_ADDR_START) || ((uint32_t)screen_start > USER_PAGES_VIR_ADDR_START + SIZE_4MB_PAGE))
           return -1;
 
-     // map the next page to the video memory addr (area past the pcb)
-     page_vir_phy_map(USER_PAGES_VIR_ADDR_START+SIZE_4MB_PAGE, VIDEO_MEM_ADDR, VIDEO_MEM_SIZE);
-     flush_tlb();
+     // map the next page to the video memory of the process' terminal (area past the program)
+     if(page_user_vidmap(active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->pid, active_terminals.current_active_terminal))
+          return -1;
 
-     *screen_start = (uint8_t *)(USER_PAGES_VIR_ADDR_START+SIZE_4MB_PAGE);
+     *screen_start = (uint8_t *)USER_VIDMAP_ADDR;
 
      return 0;
 }
@@ -488,6 +552,172 @@ int32_t sys_sigreturn(void){
      return -1;
 }
 
+/*
+ * sys_cpu_stats
+ *   DESCRIPTION: copies the cpu time statistics to user space: ticks busy and idle since boot,
+ *                ticks and voluntary sleeps of the calling process
+ *   INPUTS: stats: pointer to statistics struct in the program's page
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: 0 (success) or -1 (failure)
+ */
+int32_t sys_cpu_stats(cpu_stats_t *stats){
+     if(((uint32_t)stats < USER_PAGES_VIR_ADDR_START) || ((uint32_t)stats > USER_PAGES_VIR_ADDR_START + SIZE_4MB_PAGE - sizeof(cpu_stats_t)))
+          return -1;
+     sched_get_stats(stats);
+     return 0;
+}
+
+/*
+ * sys_set_nice
+ *   DESCRIPTION: sets the nice value of current process: 0 (default) lets it reach the highest scheduling level,
+ *                higher values keep it at lower levels, below interactive processes. programs it executes inherit it
+ *   INPUTS: nice: NICE_MIN to NICE_MAX
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: 0 (success) or -1 (failure)
+ */
+int32_t sys_set_nice(int32_t nice){
+     return sched_set_nice(nice);
+}
+
+/*
+ * sys_sleep
+ *   DESCRIPTION: suspends current process for a time (kernel timer, the other processes run meanwhile)
+ *   INPUTS: ms: time in milliseconds
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: 0 (success) or -1 (failure)
+ */
+int32_t sys_sleep(uint32_t ms){
+     return sched_sleep(ms);
+}
+
+/*
+ * sys_rw_vector
+ *   DESCRIPTION: reads or writes the buffers of a scatter/gather array, in order, through the file operation
+ *                of the fd: stops at the first short transfer (end of file, a terminal line, ...) like
+ *                consecutive reads or writes would
+ *   INPUTS: fd: file descriptor
+ *           iov: array of buffers in the program's page
+ *           iovcnt: nbr of buffers (0 to MAX_IOVEC_CNT)
+ *           write: 1 = write the buffers, 0 = read into them
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: calls specific read or write function of the file for each buffer
+ *   RETURN VALUE: total nbr of bytes read/written (success) or -1 (failure before any byte)
+ */
+static int32_t sys_rw_vector(int32_t fd, const iovec_t* iov, int32_t iovcnt, int32_t write){
+     iovec_t vec[MAX_IOVEC_CNT];   // copied: the program cannot change it in between
+     int32_t i, ret, total = 0;
+
+     if (iov == NULL || iovcnt < 0 || iovcnt > MAX_IOVEC_CNT || fd < 0 || fd >= MAX_OPEN_FILES)
+          return -1;
+     if (((uint32_t)iov < USER_PAGES_VIR_ADDR_START) || ((uint32_t)iov > USER_PAGES_VIR_ADDR_START + SIZE_4MB_PAGE - iovcnt * sizeof(iovec_t)))
+          return -1;
+     if (active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].flags == UNUSED) // if fd entry is unused dont allow operation
+          return -1;
+     memcpy(vec, iov, iovcnt * sizeof(iovec_t));
+
+     for (i = 0; i < iovcnt; i++){
+          if (vec[i].base == NULL || vec[i].len < 0)
+               break;
+          if (write)
+               ret = active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].file_op_table_ptr->write(fd, vec[i].base, vec[i].len);
+          else
+               ret = active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->fd_arr[fd].file_op_table_ptr->read(fd, vec[i].base, vec[i].len);
+          if (ret < 0)
+               break;
+          total += ret;
+          if (ret < vec[i].len) // short transfer: the next buffers would not get the bytes that follow
+               return total;
+     }
+     return (i < iovcnt && total == 0) ? -1 : total;
+}
+
+/*
+ * sys_readv
+ *   DESCRIPTION: vectored read system call: reads from an open file into several buffers, in order,
+ *                with one kernel entry
+ *   INPUTS: fd: file descriptor
+ *           iov: array of buffers (base, len)
+ *           iovcnt: nbr of buffers (0 to MAX_IOVEC_CNT)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: calls specific read function of the file for each buffer, until one is not filled
+ *   RETURN VALUE: total number of bytes read (success) or -1 (failure)
+ */
+int32_t sys_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt){
+     return sys_rw_vector(fd, iov, iovcnt, 0);
+}
+
+/*
+ * sys_writev
+ *   DESCRIPTION: vectored write system call: writes several buffers, in order, to an open file with one
+ *                kernel entry (a line built from pieces costs one system call)
+ *   INPUTS: fd: file descriptor
+ *           iov: array of buffers (base, len)
+ *           iovcnt: nbr of buffers (0 to MAX_IOVEC_CNT)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: calls specific write function of the file for each buffer
+ *   RETURN VALUE: total number of bytes written (success) or -1 (failure)
+ */
+int32_t sys_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt){
+     return sys_rw_vector(fd, iov, iovcnt, 1);
+}
+
+/*
+ * sys_ring_setup
+ *   DESCRIPTION: maps the system call ring of current process (a page of its region shared with the kernel) and
+ *                empties its queues: calls queued there are processed by sys_ring_enter, many per kernel entry
+ *   INPUTS: ring: pointer to where the address of the ring is written (in the program's page)
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: may allocate a frame
+ *   RETURN VALUE: 0 (success) or -1 (failure)
+ */
+int32_t sys_ring_setup(void** ring){
+     if(((uint32_t)ring < USER_PAGES_VIR_ADDR_START) || ((uint32_t)ring > USER_PAGES_VIR_ADDR_START + SIZE_4MB_PAGE - sizeof(void*)))
+          return -1;
+     if(ring_setup(active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->pid))
+          return -1;
+     *ring = (void*)USER_RING_ADDR;
+     return 0;
+}
+
+/*
+ * sys_ring_enter
+ *   DESCRIPTION: processes the calls queued in the system call ring of current process (read, write, open, close),
+ *                their results go to the completion queue of the ring
+ *   INPUTS: to_submit: max nbr of queued calls to process
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: those of the calls
+ *   RETURN VALUE: nbr of calls processed (success) or -1 (no ring)
+ */
+int32_t sys_ring_enter(uint32_t to_submit){
+     return ring_enter(active_terminals.terminals[active_terminals.current_active_terminal].active_pcb->pid, to_submit);
+}
+
+/*
+ * sysenter_init
+ *   DESCRIPTION: sets up the MSRs of sysenter so system calls can enter through syscall_sysenter_handler
+ *                without an interrupt frame (the gdt has the user segments right after the kernel ones,
+ *                as sysexit expects). nothing is done if the cpu has no sysenter: the library stubs
+ *                find that out with cpuid in _start and use int 0x80
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: writes the sysenter MSRs
+ *   RETURN VALUE: none
+ */
+void sysenter_init(void){
+     static uint8_t sysenter_stack[SYSENTER_STACK_SIZE];
+     uint32_t eax, ebx, ecx, edx;
+
+     asm volatile("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+     if (!(edx & CPUID_EDX_SEP))
+          return;
+     asm volatile("wrmsr" : : "c" (MSR_SYSENTER_CS), "a" (KERNEL_CS), "d" (0));
+     asm volatile("wrmsr" : : "c" (MSR_SYSENTER_ESP), "a" ((uint32_t)sysenter_stack + SYSENTER_STACK_SIZE), "d" (0));
+     asm volatile("wrmsr" : : "c" (MSR_SYSENTER_EIP), "a" ((uint32_t)syscall_sysenter_handler), "d" (0));
+}
+
 /*
  * open_bad_call
  *   DESCRIPTION: bad call for open in operation file table
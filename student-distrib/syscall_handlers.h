@@ -9,10 +9,11 @@
 #define USED              1
 #define UNUSED            0
 
-#define MAX_PROCESS_CNT   6
+#define MAX_PROCESS_CNT   64
 
-#define PCB_MEM_SPACING   0x2000                //8K
+#define PCB_MEM_SPACING   0x2000                //8K: kernel stack of a process
 #define _8MB              0x800000
+#define KSTACK_NBR_FRAMES 2                     // kernel stack: run of 2 contiguous 4kB frames
 #define USER_IMG_ADDR     0x08048000
 #define SET_IF            0x0200
 
@@ -26,6 +27,34 @@
 #define MAX_ARG_LEN       128  
 #define START_USER_FILES  2
 
+// sysenter/sysexit fast system calls (int 0x80 stays for programs built with it)
+#define CPUID_EDX_SEP            0x00000800  // cpu has sysenter/sysexit
+#define MSR_SYSENTER_CS          0x174       // code segment of sysenter (stack segment is the next one)
+#define MSR_SYSENTER_ESP         0x175
+#define MSR_SYSENTER_EIP         0x176
+#define SYSENTER_STACK_SIZE      64          // stack of the MSR: replaced by the kernel stack of the process at entry
+
+// set to 1 to print the page faults taken by each program when it halts (demand paging of images)
+#define PRINT_EXEC_FAULTS 0
+// set to 1 to print the voluntary sleeps (waits for input or rtc) of each program when it halts
+#define PRINT_EXEC_SLEEPS 0
+
+/* CPU TIME STATISTICS (sys_cpu_stats), in ticks of 20 ms */
+typedef struct cpu_stats {
+    uint32_t busy_ticks;   // ticks with a process running
+    uint32_t idle_ticks;   // ticks with no process runnable (cpu halted)
+    uint32_t task_ticks;   // ticks of the calling process
+    uint32_t task_sleeps;  // voluntary sleeps of the calling process
+} cpu_stats_t;
+
+/* I/O VECTOR (sys_readv, sys_writev): one buffer of a scatter/gather array */
+typedef struct iovec {
+    void* base;            // buffer in the program's page
+    int32_t len;           // nbr of bytes
+} iovec_t;
+
+#define MAX_IOVEC_CNT     16   // max nbr of buffers in one readv/writev
+
 /*  SYSTEM CALL HANDLERS INVOKED BY KERNEL FROM syscall_linkage.S  */
 /* halts the currently executing user program */
 int32_t sys_halt (uint8_t status);
@@ -47,6 +76,24 @@ int32_t sys_vidmap (uint8_t** screen_start);
 int32_t sys_set_handler (int32_t signum, void* handler);
 /* TBD  */
 int32_t sys_sigreturn (void);
+/* copies the cpu time statistics (system and current process) to user space */
+int32_t sys_cpu_stats (cpu_stats_t* stats);
+/* sets the nice value (best scheduling level) of current process */
+int32_t sys_set_nice (int32_t nice);
+/* suspends current process for a time in milliseconds */
+int32_t sys_sleep (uint32_t ms);
+/* reads from an open file into several buffers, in order, with one system call */
+int32_t sys_readv (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+/* writes several buffers, in order, to an open file with one system call */
+int32_t sys_writev (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+/* maps the system call ring of current process and gives its address */
+int32_t sys_ring_setup (void** ring);
+/* processes queued calls of the system call ring of current process */
+int32_t sys_ring_enter (uint32_t to_submit);
+/* sets up the sysenter entry of system calls if the cpu has it */
+void sysenter_init (void);
+/* entry of system calls made with sysenter, in syscall_linkage.S */
+extern void syscall_sysenter_handler (void);
 
 /* bad calls for terminal open and close */ 
 int32_t open_bad_call (const uint8_t* fname);
@@ -69,6 +116,13 @@ typedef struct __attribute__((packed)) file_desc_arr_entry{
     uint32_t inode_num;
     uint32_t file_position;
     uint32_t flags;
+    int32_t  file_type;   // filetype of the dentry this file was opened through (cached at open)
+    uint32_t rtc_freq;    // rtc file: virtual interrupt rate of this fd (Hz)
+    uint32_t rtc_next;    // rtc file: hardware tick of the next virtual interrupt of this fd
+    struct page_cache_page* pc_page; // regular file: page cache page of the block last read (checked before use)
+    uint32_t ra_next;     // regular file: block a sequential read continues from (last block read)
+    uint32_t ra_window;   // regular file: nbr of blocks read ahead (0: reads are not sequential)
+    uint32_t ra_end;      // regular file: first block past those already read ahead
 } fd_arr_entry_t;
 
 /* PCB */
@@ -76,14 +130,24 @@ typedef struct __attribute__((packed)) pcb {
     uint32_t pid;
 
     void* parent_pcb;  //pointer to parent pcb
-    fd_arr_entry_t fd_arr[MAX_OPEN_FILES]; // fd array for this process
+    fd_arr_entry_t* fd_arr; // fd array for this process (MAX_OPEN_FILES entries, allocated with the pcb)
     uint32_t file_inode_nbr;     //inode of exectuble file
     //saved parent registers
     uint32_t user_ebp;     //to go back to parent stack frame
     uint32_t user_esp;
     
     uint32_t tss_esp0;     //saves tss_esp0 of this process
+    uint32_t kstack_top;   //top of kernel stack of this process (tss esp0 when it runs)
     uint8_t  active;       //if this an active process
+    uint32_t terminal;     //terminal the process runs in
+    uint32_t state;        //scheduling state: TASK_RUNNING, TASK_RUNNABLE or TASK_BLOCKED (see scheduler.h)
+    struct pcb* rq_next;   //next task in run queue
+    struct pcb* wq_next;   //next task in wait queue the task sleeps on
+    uint32_t nbr_sleeps;   //nbr of voluntary sleeps (waits for input or rtc)
+    uint32_t nbr_ticks;    //nbr of ticks (20 ms) the process was running
+    uint32_t priority;     //level in multilevel feedback queue (0 = highest)
+    uint32_t slice_left;   //PIT clocks left in slice
+    uint32_t nice;         //best level of the process (set by sys_set_nice, inherited by children)
     uint8_t arg[MAX_ARG_LEN]; // argument array
     
 } pcb_t;
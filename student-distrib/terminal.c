@@ -5,10 +5,12 @@
 #include "lib.h"
 #include "tests.h"
 #include "page.h"
+#include "scheduler.h"
 
 //int32_t current_showing_terminal = 0; //global variable that holds which terminal is currently showing on screen ie. linked to main video memory (0,1 or 2)
 //int saved_screen_coord[NBR_TERMINALS][2]= {{0,0}, {0,0}, {0,0}}; //2-D array that saves most recent screen coordinates for each terminal
 terminals_t active_terminals;
+static wait_queue_t input_queues[NBR_TERMINALS]; // processes of each terminal sleeping in terminal_read until enter is pressed
 
 /* 
  * terminal_open
@@ -44,16 +46,17 @@ int terminal_close(){
  *           n   - maximum number of elements to copy
  *   OUTPUTS: none
  *   RETURN VALUE: 0 = sucesses, -1 = fail
+ *   SIDE EFFECTS: blocks the process until enter is pressed in its terminal
  */
 int32_t terminal_read(int32_t fd, void* buf, int32_t n){
     if(buf == NULL)
         return -1;
     //printf("INSIDE terminal read: trying to write to current active terminal %u\n", active_terminals.current_active_terminal);
+    cli();
     active_terminals.terminals[active_terminals.current_active_terminal].input_wait = 1; // set wait flag
     clear_KB_buffer(KB_BUF_SIZE);  // clear the Keybaord buffer to prep for input
-    sti();
-    while(active_terminals.terminals[active_terminals.current_active_terminal].input_wait){} // wait for a new line char to show up (or buf overflow)
-    cli();
+    while(active_terminals.terminals[active_terminals.current_active_terminal].input_wait) // wait for a new line char to show up (asleep: other tasks run)
+        wait_queue_sleep(&input_queues[active_terminals.current_active_terminal]);
     
     strncpy((int8_t*)buf,(const int8_t*) active_terminals.terminals[active_terminals.current_active_terminal].KB_buf, n);
     clear_KB_buffer(KB_BUF_SIZE);
@@ -63,6 +66,19 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t n){
     return strlen(buf);
 }
 
+/* 
+ * terminal_input_ready
+ *   DESCRIPTION: ends the wait of the process reading input in a terminal (enter pressed), called by the keyboard handler
+ *   INPUTS: terminal_nbr - terminal the line was typed in
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clears the wait flag of the terminal, wakes its reader
+ */
+void terminal_input_ready(int32_t terminal_nbr){
+    active_terminals.terminals[terminal_nbr].input_wait = 0;
+    wait_queue_wake(&input_queues[terminal_nbr]);
+}
+
 /* 
  * terminal_write
  *   DESCRIPTION: prints n characters to the terminal 
@@ -101,8 +117,7 @@ int32_t switch_terminal(int32_t new_terminal_nbr){
       return -2;
 
     // remap video memory location to for copy
-    k_page_vir_phy_map(VIDEO_MEM_ADDR, VIDEO_MEM_ADDR, VIDEO_MEM_SIZE);
-    flush_tlb();
+    k_page_vir_phy_map(VIDEO_MEM_ADDR, VIDEO_MEM_ADDR, VIDEO_MEM_SIZE); // invalidates the remapped page only
     //step1: save active main video page to corresponding current showing terminal video
            //also save current screen coordinates     
     memcpy((void*)(TERMINAL_1_VIDEO_PAGE_ADDR + active_terminals.current_showing_terminal*PAGE_SIZE), (const void*)VIDEO_MEM_ADDR, PAGE_SIZE); 
@@ -117,7 +132,8 @@ int32_t switch_terminal(int32_t new_terminal_nbr){
     
     active_terminals.current_showing_terminal = new_terminal_nbr;
 
-    //modify paging ie. ??? maybe for scheduling
+    // video memory of each terminal now maps to the screen (new showing terminal) or to its backing page
+    page_video_update(new_terminal_nbr);
     return 0; //for success
 }
 
@@ -141,6 +157,8 @@ void init_terminal(void){
         active_terminals.terminals[i].screen_y=0;
         active_terminals.terminals[i].buf_index=0;
         active_terminals.terminals[i].input_wait=0;
+        input_queues[i].head = NULL;
+        input_queues[i].tail = NULL;
     for(j=0; j<KB_BUF_SIZE; j++){
         active_terminals.terminals[i].KB_buf[j]= '\0';
     }
@@ -23,6 +23,9 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t n);
 // writes n chars in buf to the terminal display 
 int32_t terminal_write(int32_t fd, const void* buf, int32_t n);
 
+// wakes the process reading input in a terminal (enter pressed)
+void terminal_input_ready(int32_t terminal_nbr);
+
 // switches from one terminal to another
 int32_t switch_terminal(int32_t new_terminal_nbr);
 
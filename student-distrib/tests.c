@@ -4,6 +4,12 @@
 #include "filesystem.h"
 #include "terminal.h"
 #include "rtc.h"
+#include "frame.h"
+#include "slab.h"
+#include "timer.h"
+#include "page_cache.h"
+#include "ata.h"
+#include "bcache.h"
 
 #define PASS 1
 #define FAIL 0
@@ -15,6 +21,7 @@
 #define TEST_TERMINAL   0
 #define TEST_RTC        0
 #define TEST_SYSCALLS   0
+#define TEST_TIMER      0
 
 #define BEFORE_VIDEO_MEM_ADDR	0xB7FFF
 #define START_VIDEO_MEM_ADDR	0xB8000
@@ -31,6 +38,11 @@
 #define LS_EXE_FILE_LEN         5349         
 
 #define READ_CHUNK_SIZE         2000
+#define PC_TEST_CHUNK_SIZE      1000        // several reads per block: the fd remembers the page
+#define ATA_TEST_NBR_REQS       9
+#define SLAB_TEST_NBR_OBJS      50          // spans 2 slabs of 100B objects
+#define TIMER_TEST_NBR_TIMERS   5           // 1 ms, 64 ms, 4096 ms, TIMER_MAX_MS and one deleted
+#define TIMER_TEST_LAG_MS       8           // extra turns of the wheel (timer_add counts the ms gone since it last turned)
 /* format these macros as you see fit */
 #define TEST_HEADER 	\
 	printf("\n[TEST %s] Running %s at %s:%d\n", __FUNCTION__, __FUNCTION__, __FILE__, __LINE__)
@@ -178,6 +190,57 @@ int paging_test_should_pagefault(int region_num){
 	return FAIL;
 }
 
+/* test_frame_refcount
+ * 
+ * Asserts: a frame is freed only when its last reference is dropped (frames shared copy-on-write)
+ * Outputs: PASS/FAIL
+ * Side Effects: None (frame returned to the pool)
+ * Coverage: frame allocator
+ * Files: frame.c, frame.h
+ */
+int test_frame_refcount(){
+	TEST_HEADER;
+	uint32_t nbr_free = frame_nbr_free();
+	uint32_t frame = frame_alloc();
+	if(frame == 0 || frame_refcnt(frame) != 1 || frame_nbr_free() != nbr_free - 1)
+		return FAIL;
+	frame_get(frame);
+	frame_put(frame);
+	if(frame_refcnt(frame) != 1 || frame_nbr_free() != nbr_free - 1)
+		return FAIL;
+	frame_put(frame);
+	if(frame_refcnt(frame) != 0 || frame_nbr_free() != nbr_free)
+		return FAIL;
+	return PASS;
+}
+
+/* test_slab_alloc_free
+ * 
+ * Asserts: slab objects are cache line aligned, distinct, and their slabs go back to the frame pool once freed
+ * Outputs: PASS/FAIL (+ cache statistics)
+ * Side Effects: None
+ * Coverage: slab allocator
+ * Files: slab.c, slab.h
+ */
+int test_slab_alloc_free(){
+	TEST_HEADER;
+	static slab_cache_t test_cache = SLAB_CACHE_INITIALIZER("test", uint8_t[100]);
+	void* objs[SLAB_TEST_NBR_OBJS];
+	uint32_t nbr_free = frame_nbr_free();
+	int i, result = PASS;
+	for(i = 0; i < SLAB_TEST_NBR_OBJS; i++){
+		objs[i] = slab_alloc(&test_cache);
+		if(objs[i] == NULL || ((uint32_t)objs[i] & (SLAB_CACHE_LINE - 1)) || (i > 0 && objs[i] == objs[i - 1]))
+			result = FAIL;
+	}
+	slab_print_stats(&test_cache);
+	for(i = 0; i < SLAB_TEST_NBR_OBJS; i++)
+		slab_free(objs[i]);
+	if(test_cache.nbr_active != 0 || test_cache.nbr_slabs != 1 || frame_nbr_free() != nbr_free - 1)
+		result = FAIL;
+	return result;
+}
+
 /* Checkpoint 2 tests */
 
 /* DIRECTORY FUNCTIONS TESTS */
@@ -526,6 +589,291 @@ while (0 != (nbr_bytes_read = read_file (fd, buf, READ_CHUNK_SIZE))){
    return PASS;  
 }
 
+/* test_page_cache_read
+ * 
+ * Asserts: * a multi-block file read in small chunks through the page cache gives the same bytes as read_data
+ *          * reads inside the block of the previous read are served by the page remembered in the fd
+ *          * sequential reads grow the read-ahead window (and ask for blocks ahead when they are not cached),
+ *            a read elsewhere in the file resets it
+ * Inputs: filename: name of a regular file of more than 2 blocks
+ * Outputs: PASS/FAIL
+ * Side Effects: fills the page cache
+ * Coverage: page_cache_open, page_cache_read, page_cache_get_stats, read_data
+ * Files: page_cache.c, page_cache.h, filesystem.c
+ */
+int test_page_cache_read(uint8_t* filename){
+ TEST_HEADER;
+ uint8_t buf[PC_TEST_CHUNK_SIZE], ref_buf[PC_TEST_CHUNK_SIZE];
+ page_cache_stats_t before, after;
+ fd_arr_entry_t file;
+ dentry_t dentry;
+ int32_t nbr_bytes_read, ref_nbr_bytes_read, i;
+ uint32_t max_window = 0;
+
+ if (read_dentry_by_name(filename, &dentry) == -1 || dentry.filetype != REGULAR_FILE_TYPE)
+    return FAIL;
+ file.inode_num = dentry.inode_num;
+ file.file_position = 0;
+ file.flags = USED;
+ file.file_type = REGULAR_FILE_TYPE;
+ page_cache_open(&file);
+
+ page_cache_get_stats(&before);
+ while (0 != (nbr_bytes_read = page_cache_read(&file, buf, PC_TEST_CHUNK_SIZE))){
+    ref_nbr_bytes_read = read_data(file.inode_num, file.file_position, ref_buf, PC_TEST_CHUNK_SIZE);
+    if (nbr_bytes_read != ref_nbr_bytes_read)
+        return FAIL;
+    for (i = 0; i < nbr_bytes_read; i++)
+        if (buf[i] != ref_buf[i])
+            return FAIL;
+    file.file_position += nbr_bytes_read;
+    if (file.ra_window > max_window)
+        max_window = file.ra_window;
+ }
+ page_cache_get_stats(&after);
+ if (file.file_position != (uint32_t)get_file_size_byinode_num(file.inode_num))
+    return FAIL;   // stopped before the end of the file
+ if (after.nbr_fd_hits == before.nbr_fd_hits || after.nbr_hits - before.nbr_hits < after.nbr_fd_hits - before.nbr_fd_hits)
+    return FAIL;
+ if (max_window <= PAGE_CACHE_RA_MIN)
+    return FAIL;   // window did not grow
+ if (after.nbr_misses != before.nbr_misses && after.nbr_read_ahead == before.nbr_read_ahead)
+    return FAIL;   // blocks came from the backing store but none was asked for ahead
+
+ file.file_position = 0;  // back to the start: not sequential
+ if (page_cache_read(&file, buf, PC_TEST_CHUNK_SIZE) != PC_TEST_CHUNK_SIZE || file.ra_window != 0)
+    return FAIL;
+ return PASS;
+}
+
+static uint8_t blk_test_buf[FILESYSTEM_BLOCK_SIZE];
+static uint8_t blk_test_ref_buf[FILESYSTEM_BLOCK_SIZE];
+
+/* test_read_block
+ * 
+ * Asserts: * every block of a file read with read_block (backing store of the page cache) holds the same bytes
+ *            as read_data gives for it, and read_block gives the nbr of bytes of the file in the block
+ *          * a block past the end of the file is not read
+ * Inputs: filename: name of a regular file
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: read_block, read_data (both read the image in the boot module or through the block cache)
+ * Files: filesystem.c, bcache.c
+ */
+int test_read_block(uint8_t* filename){
+ TEST_HEADER;
+ dentry_t dentry;
+ int32_t len, ref_len, i;
+ uint32_t blk_index;
+
+ if (read_dentry_by_name(filename, &dentry) == -1 || dentry.filetype != REGULAR_FILE_TYPE)
+    return FAIL;
+ for (blk_index = 0; ; blk_index++){
+    ref_len = read_data(dentry.inode_num, blk_index * FILESYSTEM_BLOCK_SIZE, blk_test_ref_buf, FILESYSTEM_BLOCK_SIZE);
+    len = read_block(dentry.inode_num, blk_index, blk_test_buf);
+    if (ref_len == 0)
+        return (len <= 0) ? PASS : FAIL;
+    if (len != ref_len)
+        return FAIL;
+    for (i = 0; i < len; i++)
+        if (blk_test_buf[i] != blk_test_ref_buf[i])
+            return FAIL;
+ }
+}
+
+/* test_ata_queue_merge
+ * 
+ * Asserts: * requests on a queue of the test (no drive needed, nothing is sent) are kept sorted by lba
+ *          * a request continuing a command (same drive and direction) joins it: after it (back merge) or in
+ *            front of it, taking its place in the queue (front merge), with the chain and its sector count set
+ *          * requests in the other direction, on the other drive, or that would make a command larger than
+ *            ATA_MAX_SECTORS are not merged
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: ata_queue_insert (merging of ata_submit)
+ * Files: ata.c, ata.h
+ */
+int test_ata_queue_merge(){
+ TEST_HEADER;
+ ata_request_t reqs[ATA_TEST_NBR_REQS];
+ ata_request_t* queue = NULL;
+ ata_request_t* order[] = {&reqs[4], &reqs[2], &reqs[3], &reqs[8], &reqs[5], &reqs[7]};
+ ata_request_t* req;
+ // drive, lba, nbr_sectors, write, merged
+ uint32_t setup[ATA_TEST_NBR_REQS][5] = {
+    {0, 16, 8, 0, 0},
+    {0, 24, 8, 0, 1},       // back merge after 0
+    {0, 8, 8, 0, 1},        // front merge before 0: head of the chain 2, 0, 1
+    {0, 32, 8, 1, 0},       // write after the reads
+    {1, 0, 8, 0, 0},        // other drive, before 2
+    {0, 100, ATA_MAX_SECTORS - 8, 0, 0},
+    {0, 220, 8, 0, 1},      // back merge after 5: ATA_MAX_SECTORS exactly
+    {0, 228, 1, 0, 0},      // command of 5 is full
+    {0, 99, 1, 0, 0}        // (front)
+ };
+ uint32_t i;
+
+ for (i = 0; i < ATA_TEST_NBR_REQS; i++){
+    reqs[i].drive = setup[i][0];
+    reqs[i].lba = setup[i][1];
+    reqs[i].nbr_sectors = setup[i][2];
+    reqs[i].write = setup[i][3];
+    reqs[i].buf = NULL;     // never transferred
+    reqs[i].done = NULL;
+    reqs[i].priv = NULL;
+    if (ata_queue_insert(&queue, &reqs[i]) != setup[i][4] || reqs[i].status != ATA_REQ_PENDING)
+        return FAIL;
+ }
+ for (i = 0, req = queue; req != NULL; i++, req = req->next)
+    if (i >= sizeof(order) / sizeof(order[0]) || req != order[i])
+        return FAIL;
+ if (i != sizeof(order) / sizeof(order[0]))
+    return FAIL;
+ if (reqs[2].chain_sectors != 24 || reqs[2].chain_next != &reqs[0] || reqs[0].chain_next != &reqs[1] ||
+     reqs[1].chain_next != NULL || reqs[2].chain_tail != &reqs[1])
+    return FAIL;
+ if (reqs[5].chain_sectors != ATA_MAX_SECTORS || reqs[5].chain_next != &reqs[6] || reqs[5].chain_tail != &reqs[6])
+    return FAIL;
+ if (reqs[3].chain_sectors != 8 || reqs[4].chain_sectors != 8 || reqs[7].chain_sectors != 1 || reqs[8].chain_sectors != 1)
+    return FAIL;
+ return PASS;
+}
+
+/* test_bcache_get_put
+ * 
+ * Asserts: * a block got twice is a miss then a hit, in the same buffer, holding the block of the disk
+ *          * a buffer in use (not released with bcache_put) keeps its block while more blocks than the cache
+ *            holds are read through it, the others are evicted
+ * Inputs: None
+ * Outputs: PASS/FAIL (PASS with nothing tested if the image is in the boot module: the block cache is not used,
+ *          PASS after the boot block checks if the image has no more than 2 * BCACHE_NBR_BUFS blocks)
+ * Side Effects: replaces the blocks of the cache, waits for the disk
+ * Coverage: bcache_get, bcache_put, bcache_get_stats, eviction of the block cache
+ * Files: bcache.c, bcache.h
+ */
+int test_bcache_get_put(){
+ TEST_HEADER;
+ bcache_stats_t before, after;
+ bcache_buf_t* pinned;
+ bcache_buf_t* buf;
+ boot_blk_t* boot_blk;
+ uint32_t blk_nbr;
+
+ if (!filesystem_on_disk())
+    return PASS;
+ bcache_get_stats(&before);
+ if ((pinned = bcache_get(0)) == NULL)      // boot block: starts with the "." directory
+    return FAIL;
+ boot_blk = (boot_blk_t*)pinned->data;
+ if (strncmp((int8_t*)boot_blk->dir_entries[0].filename, ".", 2) != 0)
+    return FAIL;
+ if (1 + (uint32_t)boot_blk->nbr_inodes + (uint32_t)boot_blk->nbr_data_blocks <= 2 * BCACHE_NBR_BUFS){
+    bcache_put(pinned);
+    return PASS;    // image too small to read the cache over twice
+ }
+ for (blk_nbr = 1; blk_nbr <= 2 * BCACHE_NBR_BUFS; blk_nbr++){   // (blocks of the image)
+    if ((buf = bcache_get(blk_nbr)) == NULL || buf == pinned || buf->blk_nbr != blk_nbr)
+        return FAIL;
+    bcache_put(buf);
+ }
+ if ((buf = bcache_get(0)) != pinned || pinned->blk_nbr != 0 || pinned->state != BCACHE_VALID || pinned->ref_cnt != 2)
+    return FAIL;
+ bcache_put(buf);
+ bcache_put(pinned);
+ bcache_get_stats(&after);
+ if (after.nbr_hits == before.nbr_hits ||
+     after.nbr_misses - before.nbr_misses < 2 * BCACHE_NBR_BUFS + 1 - BCACHE_NBR_BUFS)
+    return FAIL;    // at most BCACHE_NBR_BUFS blocks were cached before
+ if ((buf = bcache_get(1)) == NULL)         // evicted by the last blocks read
+    return FAIL;
+ bcache_put(buf);
+ bcache_get_stats(&before);
+ return (before.nbr_misses == after.nbr_misses + 1) ? PASS : FAIL;
+}
+
+/* test_dentry_name_index
+ * 
+ * Asserts: * every dentry present in the boot block is found by name through the hashed name index
+ *          * the dentry found by name is the same one found by index
+ *          * prefixes of existing names and names longer than MAX_FILENAME_LEN are not found
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: FS initializaiton (dentry name index), read_dentry_by_name
+ * Files: filesytem.c, filesytem.h
+ */
+int test_dentry_name_index(){
+ TEST_HEADER;
+ int32_t dentry_i, char_i;
+ dentry_t by_index, by_name;
+ uint8_t fname[MAX_FILENAME_LEN + 1];
+
+ for (dentry_i = 0; dentry_i < get_num_dentries_present(); dentry_i++){
+    if (read_dentry_by_index(dentry_i, &by_index) == -1)
+        return FAIL;
+    for (char_i = 0; char_i < MAX_FILENAME_LEN; char_i++)
+        fname[char_i] = by_index.filename[char_i];
+    fname[MAX_FILENAME_LEN] = '\0'; // names of exactly MAX_FILENAME_LEN chars are not NUL terminated in the dentry
+    if (read_dentry_by_name(fname, &by_name) == -1 || by_name.inode_num != by_index.inode_num)
+        return FAIL;
+ }
+ if (read_dentry_by_name((uint8_t*)"she", &by_name) != -1) // prefix of "shell"
+    return FAIL;
+ if (read_dentry_by_name((uint8_t*)"verylargetextwithverylongname.txt", &by_name) != -1) // exceeds MAX_FILENAME_LEN
+    return FAIL;
+ return PASS;
+}
+
+/* timer wheel test: ms of wheel turned so far and what each timer saw */
+static uint32_t timer_test_now;
+static uint32_t timer_test_fired[TIMER_TEST_NBR_TIMERS];
+static uint32_t timer_test_when[TIMER_TEST_NBR_TIMERS];
+
+/* expiry function of the timer wheel test: data is the index of the timer */
+static void timer_test_fn(void* data){
+    timer_test_fired[(uint32_t)data]++;
+    timer_test_when[(uint32_t)data] = timer_test_now;
+}
+
+/* test_timer_wheel
+ * 
+ * Asserts: * timers of 1 ms, 64 ms, 4096 ms (first slots of levels 0, 1, 2) and TIMER_MAX_MS (last level) fire
+ *            exactly once, no earlier than their delay, after cascading down the levels
+ *          * a timer deleted while at the head of its slot never fires and leaves the other timers of the slot
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: turns the wheel by TIMER_MAX_MS ms (interrupts off)
+ * Coverage: timer_add, timer_del, timer insert/unlink/cascade
+ * Files: timer.c, timer.h
+ */
+int test_timer_wheel(){
+ TEST_HEADER;
+ uint32_t delays[TIMER_TEST_NBR_TIMERS] = {1, 64, 4096, TIMER_MAX_MS, 64};
+ ktimer_t timers[TIMER_TEST_NBR_TIMERS];
+ uint32_t i, flags;
+
+ cli_and_save(flags);
+ timer_test_now = 0;
+ for (i = 0; i < TIMER_TEST_NBR_TIMERS; i++){
+    timer_test_fired[i] = 0;
+    timers[i].pending = 0;
+    timer_add(&timers[i], delays[i], timer_test_fn, (void*)i);
+ }
+ timer_del(&timers[TIMER_TEST_NBR_TIMERS - 1]); // added last to the slot of the 64 ms timer: its head
+ for (timer_test_now = 1; timer_test_now <= TIMER_MAX_MS + TIMER_TEST_LAG_MS; timer_test_now++)
+    timer_advance(1);
+ restore_flags(flags);
+
+ for (i = 0; i < TIMER_TEST_NBR_TIMERS - 1; i++){
+    if (timer_test_fired[i] != 1 || timer_test_when[i] < delays[i] || timers[i].pending)
+        return FAIL;
+ }
+ if (timer_test_fired[TIMER_TEST_NBR_TIMERS - 1] != 0)
+    return FAIL;
+ return PASS;
+}
+
 /* test_terminal_rw
  * 
  * Asserts: termianal read and write functionality
@@ -619,6 +967,8 @@ void launch_tests(){
 
 	if(TEST_PAGING){
      TEST_OUTPUT("paging_test_should_reference", paging_test_should_reference(7));  //change region tested by changing integer argument (index to "physical_memory_addr_regions" above)
+	 TEST_OUTPUT("test_frame_refcount", test_frame_refcount());
+	 TEST_OUTPUT("test_slab_alloc_free", test_slab_alloc_free());
 	 TEST_OUTPUT("paging_test_should_pagefault", paging_test_should_pagefault(0));
 	} 
     
@@ -641,8 +991,14 @@ void launch_tests(){
 	// TEST_OUTPUT("test_read_large_file", test_read_large_file());
 	// TEST_OUTPUT("test_read_exe_file", test_read_exe_file());
 
+	TEST_OUTPUT("test_dentry_name_index", test_dentry_name_index());
+
 	uint8_t filename[MAX_FILENAME_LEN] = "frame1.txt";
 	TEST_OUTPUT("test_read_file_by_chunks", test_read_file_by_chunks(filename));
+	TEST_OUTPUT("test_page_cache_read", test_page_cache_read((uint8_t*)"fish"));
+	TEST_OUTPUT("test_read_block", test_read_block((uint8_t*)"fish"));
+	TEST_OUTPUT("test_ata_queue_merge", test_ata_queue_merge());
+	TEST_OUTPUT("test_bcache_get_put", test_bcache_get_put());
 
     }
 
@@ -652,6 +1008,10 @@ void launch_tests(){
 	TEST_OUTPUT("test terminal w/r", test_terminal_rw());
 	}
 
+	if(TEST_TIMER){
+    TEST_OUTPUT("test_timer_wheel", test_timer_wheel());
+	}
+
 	if(TEST_RTC){
     TEST_OUTPUT("test rtc freq w/r", test_freq());
   
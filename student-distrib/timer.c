@@ -0,0 +1,219 @@
+/* timer.c - Defines kernel timers: hierarchical timer wheel driven by the PIT
+ * vim:ts=4 noexpandtab
+ */
+
+#include "timer.h"
+#include "lib.h"
+
+// wheel[level][slot]: lists of pending timers. a timer is kept at the level its distance to expiry needs,
+// in the slot of its expiry time at that level; a slot of a higher level is cascaded (spread over the
+// levels below) when the wheel time reaches it
+static ktimer_t* wheel[TIMER_NBR_LEVELS][TIMER_WHEEL_SIZE];
+static uint32_t timer_jiffies = 0;      // wheel time (ms), every timer expiring before it has run
+static uint32_t timer_clock = 0;        // PIT_now() at the wheel time
+static uint32_t timer_nbr_pending = 0;  // nbr of timers in the wheel
+
+/*
+ * timer_insert
+ *   DESCRIPTION: links a timer in the slot of its expiry time, at the level of its distance to expiry
+ *   INPUTS: timer: timer expiring at or after the wheel time
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: modifies wheel
+ *   RETURN VALUE: none
+ */
+static void timer_insert(ktimer_t* timer){
+    uint32_t delta = timer->expires - timer_jiffies;
+    uint32_t level, slot;
+
+    for(level = 0; level < TIMER_NBR_LEVELS - 1 && delta >= (1 << (TIMER_WHEEL_BITS * (level + 1))); level++);
+    slot = (timer->expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    timer->prev = NULL;
+    timer->next = wheel[level][slot];
+    if(timer->next != NULL)
+        timer->next->prev = timer;
+    wheel[level][slot] = timer;
+}
+
+/*
+ * timer_unlink
+ *   DESCRIPTION: removes a pending timer from its slot
+ *   INPUTS: timer: pending timer
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: modifies wheel
+ *   RETURN VALUE: none
+ */
+static void timer_unlink(ktimer_t* timer){
+    uint32_t level, slot;
+
+    if(timer->prev != NULL)
+        timer->prev->next = timer->next;
+    else{   // head of its slot: find the slot the way timer_insert (or the last cascade) chose it
+        for(level = 0; level < TIMER_NBR_LEVELS; level++){
+            slot = (timer->expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+            if(wheel[level][slot] == timer){
+                wheel[level][slot] = timer->next;
+                break;
+            }
+        }
+    }
+    if(timer->next != NULL)
+        timer->next->prev = timer->prev;
+    timer->prev = timer->next = NULL;
+}
+
+/*
+ * timer_step
+ *   DESCRIPTION: turns the wheel by one ms: cascades the slots of the higher levels reached, then runs the timers
+ *                expiring now
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: calls the functions of the timers expired
+ *   RETURN VALUE: none
+ */
+static void timer_step(void){
+    ktimer_t* list;
+    ktimer_t* timer;
+    uint32_t level;
+
+    timer_jiffies++;
+    for(level = 1; level < TIMER_NBR_LEVELS && (timer_jiffies & ((1 << (TIMER_WHEEL_BITS * level)) - 1)) == 0; level++){
+        list = wheel[level][(timer_jiffies >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK];
+        wheel[level][(timer_jiffies >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK] = NULL;
+        while((timer = list) != NULL){
+            list = timer->next;
+            timer_insert(timer);
+        }
+    }
+    list = wheel[0][timer_jiffies & TIMER_WHEEL_MASK];
+    wheel[0][timer_jiffies & TIMER_WHEEL_MASK] = NULL;
+    while((timer = list) != NULL){
+        list = timer->next;
+        timer->prev = timer->next = NULL;
+        timer->pending = 0;
+        timer_nbr_pending--;
+        timer->fn(timer->data);
+    }
+}
+
+/*
+ * timer_add
+ *   DESCRIPTION: starts a timer in constant time (restarts it if pending). the caller has the PIT programmed for it
+ *                (the scheduler does when the running task blocks or the timer interrupt ends)
+ *   INPUTS: timer: timer to start
+ *           ms: delay in milliseconds (1 to TIMER_MAX_MS, clamped): fn never runs before ms have gone by
+ *           fn: function called on expiry with data, in the timer interrupt (interrupts off)
+ *           data: argument of fn
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: modifies wheel
+ *   RETURN VALUE: none
+ */
+void timer_add(ktimer_t* timer, uint32_t ms, void (*fn)(void* data), void* data){
+    uint32_t flags, gone, lag;
+
+    if(ms == 0)
+        ms = 1;
+    if(ms > TIMER_MAX_MS)
+        ms = TIMER_MAX_MS;
+    cli_and_save(flags);
+    if(timer->pending){
+        timer_unlink(timer);
+        timer_nbr_pending--;
+    }
+    if(timer_nbr_pending == 0)          // wheel was stopped (and the PIT may have been): its time is now
+        timer_clock = PIT_now();
+    gone = PIT_now() - timer_clock;     // time gone since the wheel last turned, rounded up: never expires early
+    lag = (gone + TIMER_CLOCKS_PER_MS - 1) / TIMER_CLOCKS_PER_MS;
+    timer->expires = timer_jiffies + lag + ms;
+    if(lag + ms > TIMER_MAX_MS)
+        timer->expires = timer_jiffies + TIMER_MAX_MS;
+    timer->fn = fn;
+    timer->data = data;
+    timer->pending = 1;
+    timer_insert(timer);
+    timer_nbr_pending++;
+    restore_flags(flags);
+}
+
+/*
+ * timer_del
+ *   DESCRIPTION: stops a pending timer in constant time (does nothing if it is not pending)
+ *   INPUTS: timer: timer
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: modifies wheel
+ *   RETURN VALUE: none
+ */
+void timer_del(ktimer_t* timer){
+    uint32_t flags;
+    cli_and_save(flags);
+    if(timer->pending){
+        timer_unlink(timer);
+        timer->pending = 0;
+        timer_nbr_pending--;
+    }
+    restore_flags(flags);
+}
+
+/*
+ * timer_run
+ *   DESCRIPTION: called on the timer interrupt: turns the wheel by the ms gone since it last turned, running the
+ *                timers expired on the way. with no timer pending the wheel time just moves to now
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: calls the functions of the timers expired
+ *   RETURN VALUE: none
+ */
+void timer_run(void){
+    uint32_t ms = (PIT_now() - timer_clock) / TIMER_CLOCKS_PER_MS;
+
+    if(timer_nbr_pending == 0){
+        timer_jiffies += ms;
+        timer_clock += ms * TIMER_CLOCKS_PER_MS;
+        return;
+    }
+    for(; ms > 0; ms--){
+        timer_clock += TIMER_CLOCKS_PER_MS;
+        timer_step();
+    }
+}
+
+/*
+ * timer_next_clocks
+ *   DESCRIPTION: gives the time until the wheel must turn: the first slot of the lowest level with timers, or the
+ *                next cascade of a higher level, whichever comes first
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: none
+ *   RETURN VALUE: PIT clocks (at least 1), TIMER_NONE if no timer is pending
+ */
+uint32_t timer_next_clocks(void){
+    uint32_t ms, gone;
+
+    if(timer_nbr_pending == 0)
+        return TIMER_NONE;
+    for(ms = 1; ms < TIMER_WHEEL_SIZE; ms++){
+        if(wheel[0][(timer_jiffies + ms) & TIMER_WHEEL_MASK] != NULL || ((timer_jiffies + ms) & TIMER_WHEEL_MASK) == 0)
+            break;
+    }
+    gone = PIT_now() - timer_clock;
+    if(gone >= ms * TIMER_CLOCKS_PER_MS)
+        return 1;
+    return ms * TIMER_CLOCKS_PER_MS - gone;
+}
+
+/*
+ * timer_advance
+ *   DESCRIPTION: turns the wheel by ms one ms at a time, running the timers expired on the way, whatever the PIT
+ *                says (kernel tests drive the wheel with it, interrupts off). the wheel time then stays ahead of the
+ *                PIT clock, which only delays the timers started after
+ *   INPUTS: ms: nbr of ms to turn the wheel by
+ *   OUTPUTS: none
+ *   SIDE EFFECTS: calls the functions of the timers expired
+ *   RETURN VALUE: none
+ */
+void timer_advance(uint32_t ms){
+    uint32_t flags;
+    cli_and_save(flags);
+    for(; ms > 0; ms--)
+        timer_step();
+    restore_flags(flags);
+}
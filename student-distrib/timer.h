@@ -0,0 +1,40 @@
+/* timer.h - Defines kernel timers: hierarchical timer wheel driven by the PIT
+ * vim:ts=4 noexpandtab
+ */
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "types.h"
+#include "pit.h"
+
+// the wheel turns every ms; each level has 64 slots, a slot of a level spans the whole level below
+#define TIMER_CLOCKS_PER_MS   (PIT_FREQUENCY / 1000)   // PIT clocks in a wheel tick
+#define TIMER_WHEEL_BITS      6
+#define TIMER_WHEEL_SIZE      (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK      (TIMER_WHEEL_SIZE - 1)
+#define TIMER_NBR_LEVELS      4                        // slots of 1 ms, 64 ms, 4 s, 4.4 min: up to 4.6 h
+#define TIMER_MAX_MS          ((1 << (TIMER_WHEEL_BITS * TIMER_NBR_LEVELS)) - 1)
+#define TIMER_NONE            0xFFFFFFFF
+
+/* KERNEL TIMER: embedded in the object it times (no allocation) */
+typedef struct ktimer {
+    struct ktimer* prev;        // in slot list of wheel
+    struct ktimer* next;
+    uint32_t expires;           // wheel time (ms) of expiry
+    uint32_t pending;           // in the wheel
+    void (*fn)(void* data);     // called on expiry, in the timer interrupt
+    void* data;
+} ktimer_t;
+
+/* starts a timer: fn(data) is called in ms milliseconds (at least 1), O(1) */
+void timer_add(ktimer_t* timer, uint32_t ms, void (*fn)(void* data), void* data);
+/* stops a pending timer, O(1) */
+void timer_del(ktimer_t* timer);
+/* timer interrupt: turns the wheel up to now and runs the timers expired */
+void timer_run(void);
+/* gives the PIT clocks until the wheel needs to turn again, TIMER_NONE if no timer is pending */
+uint32_t timer_next_clocks(void);
+/* turns the wheel by ms without the PIT (kernel tests, interrupts off) */
+void timer_advance(uint32_t ms);
+
+#endif /* TIMER_H */
@@ -12,6 +12,9 @@
 #ifndef ASM
 
 /* Types defined here just like in <stdint.h>  */
+typedef long long int64_t;
+typedef unsigned long long uint64_t;
+
 typedef int int32_t;
 typedef unsigned int uint32_t;
 
@@ -42,10 +42,12 @@ do_one_file (const char* s, const char* fname)
 	    for (check = line_start; check < line_end; check++) {
 		if (s[0] == data[check] && 
 		    0 == ece391_strncmp ((uint8_t*)(data + check), (uint8_t*)s, s_len)) {
-		    ece391_fdputs (1, (uint8_t*)fname);
-		    ece391_fdputs (1, (uint8_t*)":");
-		    ece391_fdputs (1, data + line_start);
-		    ece391_fdputs (1, (uint8_t*)"\n");
+		    const uint8_t* out[4];
+		    out[0] = (uint8_t*)fname;
+		    out[1] = (uint8_t*)":";
+		    out[2] = data + line_start;
+		    out[3] = (uint8_t*)"\n";
+		    ece391_fdputsv (1, out, 4);
 		    break;
 		}
 	    }
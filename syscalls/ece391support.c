@@ -21,6 +21,48 @@ void ece391_fdputs(int32_t fd, const uint8_t* s)
     (void)ece391_write (fd, s, ece391_strlen(s));
 }
 
+/* Write n strings (at most ECE391_IOV_MAX) with one system call */
+void ece391_fdputsv(int32_t fd, const uint8_t* const* s, int32_t n)
+{
+    ece391_iovec_t iov[ECE391_IOV_MAX];
+    int32_t i;
+
+    if (n > ECE391_IOV_MAX)
+        n = ECE391_IOV_MAX;
+    for (i = 0; i < n; i++) {
+        iov[i].base = (void*)s[i];
+        iov[i].len = ece391_strlen(s[i]);
+    }
+    (void)ece391_writev (fd, iov, n);
+}
+
+/* Queue a call in the system call ring (run by the next ece391_ring_enter), 0 or -1 if the queue is full */
+int32_t ece391_ring_queue(ece391_ring_t* ring, int32_t opcode, int32_t fd, void* buf, int32_t len, uint32_t user_data)
+{
+    ece391_ring_sqe_t* sqe;
+
+    if (ring->sq_tail - ring->sq_head >= ECE391_RING_ENTRIES)
+        return -1;
+    sqe = &ring->sq[ring->sq_tail % ECE391_RING_ENTRIES];
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->buf = buf;
+    sqe->len = len;
+    sqe->user_data = user_data;
+    ring->sq_tail++;
+    return 0;
+}
+
+/* Take a completion from the system call ring without a system call, 1 if one was taken or 0 */
+int32_t ece391_ring_reap(ece391_ring_t* ring, ece391_ring_cqe_t* cqe)
+{
+    if (ring->cq_head == ring->cq_tail)
+        return 0;
+    *cqe = ring->cq[ring->cq_head % ECE391_RING_ENTRIES];
+    ring->cq_head++;
+    return 1;
+}
+
 int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2)
 {
     while (*s1 == *s2) {
@@ -1,9 +1,14 @@
 #if !defined(ECE391SUPPORT_H)
 #define ECE391SUPPORT_H
 
+#include "ece391syscall.h"
+
 extern uint32_t ece391_strlen(const uint8_t* s);
 extern void ece391_strcpy(uint8_t* dst, const uint8_t* src);
 extern void ece391_fdputs(int32_t fd, const uint8_t* s);
+extern void ece391_fdputsv(int32_t fd, const uint8_t* const* s, int32_t n);
+extern int32_t ece391_ring_queue(ece391_ring_t* ring, int32_t opcode, int32_t fd, void* buf, int32_t len, uint32_t user_data);
+extern int32_t ece391_ring_reap(ece391_ring_t* ring, ece391_ring_cqe_t* cqe);
 extern int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2);
 extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
@@ -5,6 +5,57 @@
 
 /* All calls return >= 0 on success or -1 on failure. */
 
+/* cpu time filled by cpu_stats, in timer ticks (20 ms) */
+typedef struct ece391_cpu_stats {
+    uint32_t busy_ticks;   /* ticks with a program running     */
+    uint32_t idle_ticks;   /* ticks with the cpu halted        */
+    uint32_t task_ticks;   /* ticks of the calling program     */
+    uint32_t task_sleeps;  /* waits of the calling program for input or rtc */
+} ece391_cpu_stats_t;
+
+/* one buffer of the scatter/gather array of readv and writev */
+#define ECE391_IOV_MAX 16
+typedef struct ece391_iovec {
+    void* base;
+    int32_t len;
+} ece391_iovec_t;
+
+/*
+ * System call ring, mapped by ring_setup: calls queued in the submission
+ * queue (sq_tail advanced by the program) are run by one ring_enter, and
+ * their results appear in the completion queue (cq_tail advanced by the
+ * kernel), where they are taken without a system call. Entries are
+ * indexed by the free-running counters modulo ECE391_RING_ENTRIES.
+ */
+#define ECE391_RING_ENTRIES 128
+#define ECE391_RING_NOP     0
+#define ECE391_RING_READ    1
+#define ECE391_RING_WRITE   2
+#define ECE391_RING_OPEN    3   /* buf is the file name */
+#define ECE391_RING_CLOSE   4
+
+typedef struct ece391_ring_sqe {
+    int32_t opcode;
+    int32_t fd;
+    void* buf;
+    int32_t len;
+    uint32_t user_data;    /* copied to the completion */
+} ece391_ring_sqe_t;
+
+typedef struct ece391_ring_cqe {
+    uint32_t user_data;
+    int32_t res;           /* return value of the call */
+} ece391_ring_cqe_t;
+
+typedef struct ece391_ring {
+    uint32_t sq_head;
+    uint32_t sq_tail;
+    uint32_t cq_head;
+    uint32_t cq_tail;
+    ece391_ring_sqe_t sq[ECE391_RING_ENTRIES];
+    ece391_ring_cqe_t cq[ECE391_RING_ENTRIES];
+} ece391_ring_t;
+
 /*  
  * Note that the system call for halt will have to make sure that only
  * the low byte of EBX (the status argument) is returned to the calling
@@ -21,6 +72,13 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_cpu_stats (ece391_cpu_stats_t* stats);
+extern int32_t ece391_set_nice (int32_t nice);
+extern int32_t ece391_sleep (uint32_t ms);
+extern int32_t ece391_readv (int32_t fd, const ece391_iovec_t* iov, int32_t iovcnt);
+extern int32_t ece391_writev (int32_t fd, const ece391_iovec_t* iov, int32_t iovcnt);
+extern int32_t ece391_ring_setup (ece391_ring_t** ring);
+extern int32_t ece391_ring_enter (uint32_t to_submit);
 
 enum signums {
 	DIV_ZERO = 0,
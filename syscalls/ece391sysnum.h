@@ -11,5 +11,12 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_CPU_STATS  11
+#define SYS_SET_NICE   12
+#define SYS_SLEEP      13
+#define SYS_READV      14
+#define SYS_WRITEV     15
+#define SYS_RING_SETUP 16
+#define SYS_RING_ENTER 17
 
 #endif /* ECE391SYSNUM_H */